@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <display.h>
+
+#define SERIES_SIZE (1 << 20)
+#define GRID_ROWS 512
+#define GRID_COLS 2048
+
+/*
+ * Measures how long the chart primitives take to draw large inputs into
+ * a window: a sparkline of a long series, bars of many values and a
+ * heatmap of a large grid, each shrunk to the box by averaging and
+ * scaled to its own range.
+ * Usage: chartBench [seconds]
+ */
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static window_t *window;
+static float *series;
+static float *grid;
+static color_value_t ramp[8];
+
+static void drawSparkline(void)
+{
+	windowSparkline(window, series, SERIES_SIZE, 0, 0, COLOR_RGB(0, 200, 0), 0, 0, 80);
+}
+
+static void drawBars(void)
+{
+	windowBars(window, series, SERIES_SIZE, 0, 0, 1, COLOR_RGB(200, 200, 0), 1, 0, 20, 80);
+}
+
+static void drawHeatmap(void)
+{
+	windowHeatmap(window, grid, GRID_ROWS, GRID_COLS, 0, 0, ramp, 8, 21, 0, 18, 80);
+}
+
+static void run(const char *name, void (*draw)(void), double seconds, size_t samples)
+{
+	unsigned long calls = 0;
+	double start = now();
+	double elapsed;
+	do
+	{
+		draw();
+		calls++;
+		elapsed = now() - start;
+	} while (elapsed < seconds);
+	printf("%-10s %8lu calls, %8.1f us/call, %6.2f ns/sample\n", name, calls,
+			elapsed / calls * 1e6, elapsed / calls / samples * 1e9);
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+	FILE *term = fopen("/dev/null", "w");
+	display_t *display = newDisplay(term, 40, 80);
+	window = newWindow(display, 0, 0, 0, 40, 80);
+
+	series = (float *)malloc(sizeof(float) * SERIES_SIZE);
+	grid = (float *)malloc(sizeof(float) * GRID_ROWS * GRID_COLS);
+	int i;
+	for (i = 0; i < SERIES_SIZE; i++)
+		series[i] = sinf(i * 0.001f) * 100 + (rand() % 100) * 0.1f;
+	for (i = 0; i < GRID_ROWS * GRID_COLS; i++)
+		grid[i] = (float)(rand() % 1000);
+	for (i = 0; i < 8; i++)
+		ramp[i] = COLOR_RGB(i * 32, 0, 255 - i * 32);
+
+	run("sparkline", drawSparkline, seconds, SERIES_SIZE);
+	run("bars", drawBars, seconds, SERIES_SIZE);
+	run("heatmap", drawHeatmap, seconds, (size_t)GRID_ROWS * GRID_COLS);
+
+	free(series);
+	free(grid);
+	freeDisplay(display);
+	fclose(term);
+	return 0;
+}
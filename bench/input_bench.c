@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <display.h>
+
+#define SAMPLE_SIZE (1 << 20)
+#define EVENTS 256
+
+/*
+ * Measures how many input events per second the decoder turns out for a
+ * mix of typing, arrow keys, mouse reports and pastes.
+ * Usage: inputBench [seconds]
+ */
+
+static size_t buildSample(unsigned char *data, size_t size)
+{
+	static const char *pieces[] = {
+		"hello world ",
+		"\033[A", "\033[B", "\033[1;5C", "\033[D",
+		"\033[<0;12;5M", "\033[<0;12;5m", "\033[<32;40;20M", "\033[<64;3;3M",
+		"\033[3~", "\033[5;2~", "\033OP", "\033x",
+		"\303\251\342\202\254",
+		"\033[200~pasted text\nwith two lines\033[201~"
+	};
+	size_t count = sizeof(pieces) / sizeof(pieces[0]);
+	size_t length = 0;
+	size_t i = 0;
+	for (;;)
+	{
+		size_t n = strlen(pieces[i]);
+		if (length + n > size)
+			break;
+		memcpy(data + length, pieces[i], n);
+		length += n;
+		i = (i + 1) % count;
+	}
+	return length;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+	FILE *term = fopen("/dev/null", "w");
+	display_t *display = newDisplay(term, 40, 80);
+	newWindow(display, 1, 2, 2, 10, 30);
+	newWindow(display, 1, 8, 20, 20, 50);
+
+	int fds[2];
+	if (pipe(fds) != 0)
+		return 1;
+	input_t *input = newInput(display, fds[0]);
+
+	unsigned char *sample = (unsigned char *)malloc(SAMPLE_SIZE);
+	size_t length = buildSample(sample, SAMPLE_SIZE);
+	input_event_t events[EVENTS];
+
+	unsigned long long total = 0;
+	unsigned long long bytes = 0;
+	double start = now();
+	double elapsed;
+	do
+	{
+		size_t pos = 0;
+		while (pos < length)
+		{
+			size_t used;
+			total += inputParse(input, sample + pos, length - pos, events, EVENTS, &used);
+			pos += used;
+		}
+		bytes += length;
+		elapsed = now() - start;
+	} while (elapsed < seconds);
+
+	printf("%llu events from %llu bytes in %.2f s\n", total, bytes, elapsed);
+	printf("%.1f M events/s, %.1f MB/s\n", total / elapsed / 1e6, bytes / elapsed / 1e6);
+
+	freeInput(input);
+	close(fds[0]);
+	close(fds[1]);
+	free(sample);
+	freeDisplay(display);
+	fclose(term);
+	return 0;
+}
@@ -0,0 +1,329 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "display_internal.h"
+
+/*
+ * Glyphs for eight sparkline levels, lowest first.
+ */
+static const char spark_glyphs[] = "_.-=+*#@";
+#define SPARK_LEVELS 8
+
+/**
+ * This function moves a box of a window's content into raw window
+ * coordinates and clips it to the content.
+ *
+ * @return FALSE when nothing of the box is left
+ */
+static char clipBox(window_t *window, int *x, int *y, int *rows, int *cols)
+{
+	int d = window->boarder ? 1: 0;
+	int x0 = *x + d;
+	int y0 = *y + d;
+	int x1 = x0 + *rows;
+	int y1 = y0 + *cols;
+	if (x0 < d) x0 = d;
+	if (y0 < d) y0 = d;
+	if (x1 > window->dim.x - d) x1 = window->dim.x - d;
+	if (y1 > window->dim.y - d) y1 = window->dim.y - d;
+	*x = x0;
+	*y = y0;
+	*rows = x1 - x0;
+	*cols = y1 - y0;
+	return x0 < x1 && y0 < y1;
+}
+
+/**
+ * This function finds the smallest and largest of a series.
+ * A single running min and max is a chain of dependent compares the
+ * compiler will not reorder, so the series is walked RANGE_LANES values
+ * at a time with a min and max per lane. The lanes are independent, and
+ * GCC turns each step into vector min and max instructions at -O2 and
+ * above. The lanes are folded together at the end.
+ */
+#define RANGE_LANES 8
+
+static void seriesRange(const float *values, int count, float *min, float *max)
+{
+	float lo[RANGE_LANES];
+	float hi[RANGE_LANES];
+	int i, k;
+	for (k = 0; k < RANGE_LANES; k++)
+	{
+		lo[k] = values[0];
+		hi[k] = values[0];
+	}
+	for (i = 0; i + RANGE_LANES <= count; i += RANGE_LANES)
+	{
+		for (k = 0; k < RANGE_LANES; k++)
+		{
+			lo[k] = values[i + k] < lo[k] ? values[i + k] : lo[k];
+			hi[k] = values[i + k] > hi[k] ? values[i + k] : hi[k];
+		}
+	}
+	for (; i < count; i++)
+	{
+		lo[0] = values[i] < lo[0] ? values[i] : lo[0];
+		hi[0] = values[i] > hi[0] ? values[i] : hi[0];
+	}
+	for (k = 1; k < RANGE_LANES; k++)
+	{
+		lo[0] = lo[k] < lo[0] ? lo[k] : lo[0];
+		hi[0] = hi[k] > hi[0] ? hi[k] : hi[0];
+	}
+	*min = lo[0];
+	*max = hi[0];
+}
+
+/**
+ * This function shrinks a series to a number of buckets, each the mean of
+ * its samples. A series shorter than the buckets fills only count of them.
+ *
+ * @return the number of buckets filled
+ */
+static int seriesBuckets(const float *values, int count, float *buckets, int size)
+{
+	if (count <= size)
+	{
+		memcpy(buckets, values, sizeof(float) * count);
+		return count;
+	}
+	int b;
+	for (b = 0; b < size; b++)
+	{
+		int start = (int)((long long)b * count / size);
+		int end = (int)((long long)(b + 1) * count / size);
+		float sum = 0;
+		int i;
+		for (i = start; i < end; i++)
+			sum += values[i];
+		buckets[b] = sum / (end - start);
+	}
+	return size;
+}
+
+/**
+ * This function picks the range a chart is scaled to: min and max when
+ * they make one, the range of the values otherwise.
+ */
+static void chartRange(const float *values, int count, float *min, float *max)
+{
+	if (*min < *max)
+		return;
+	seriesRange(values, count, min, max);
+	if (*min == *max)
+		*max = *min + 1;
+}
+
+/**
+ * This function writes a row of glyphs into a window in one color,
+ * leaving the background alone.
+ */
+static void writeGlyphs(window_t *window, int x, int y, const char *glyphs, int cols, color_t color)
+{
+	memcpy(window->contents[x] + y, glyphs, cols);
+	memset(window->attrs[x] + y, window->attr, cols);
+	memset(window->colors[x] + y, color, cols);
+}
+
+/**
+ * This function draws a series as a sparkline along one row of a window.
+ * Long series are shrunk to the width by averaging; short ones take one
+ * column per sample. The series is scaled to min and max, or to its own
+ * range when max is not above min.
+ *
+ * @param window the window being drawn in
+ * @param values the series
+ * @param count the number of samples
+ * @param min the value at the bottom
+ * @param max the value at the top
+ * @param color the color of the line
+ * @param x the row
+ * @param y the first column
+ * @param cols the number of columns
+ */
+void windowSparkline(window_t *window,
+				const float *values,
+				int count,
+				float min,
+				float max,
+				color_value_t color,
+				int x,
+				int y,
+				int cols)
+{
+	int rows = 1;
+	if (count <= 0 || !clipBox(window, &x, &y, &rows, &cols))
+		return;
+	float *buckets = (float *)malloc(sizeof(float) * cols);
+	char *glyphs = (char *)malloc(cols);
+	int used = seriesBuckets(values, count, buckets, cols);
+	chartRange(buckets, used, &min, &max);
+	float scale = SPARK_LEVELS / (max - min);
+	int j;
+	for (j = 0; j < used; j++)
+	{
+		int level = (int)((buckets[j] - min) * scale);
+		level = level < 0 ? 0 : level >= SPARK_LEVELS ? SPARK_LEVELS - 1 : level;
+		glyphs[j] = spark_glyphs[level];
+	}
+	memset(glyphs + used, ' ', cols - used);
+	writeGlyphs(window, x, y, glyphs, cols, windowPaletteSlot(window, color));
+	windowDamage(window, x, y, x + 1, y + cols);
+	free(buckets);
+	free(glyphs);
+}
+
+/**
+ * This function draws a series as bars filling a box of a window, one
+ * column per bar growing up when vertical, one row per bar growing right
+ * otherwise. A single value makes a gauge. Bars are scaled from min to
+ * max, or from 0 to the largest value when max is not above min. More
+ * values than bars are averaged together.
+ *
+ * @param window the window being drawn in
+ * @param values the series
+ * @param count the number of values
+ * @param min the value of an empty bar
+ * @param max the value of a full bar
+ * @param vertical TRUE for columns, FALSE for rows
+ * @param color the color of the bars
+ * @param x the first row
+ * @param y the first column
+ * @param rows the number of rows
+ * @param cols the number of columns
+ */
+void windowBars(window_t *window,
+				const float *values,
+				int count,
+				float min,
+				float max,
+				char vertical,
+				color_value_t color,
+				int x,
+				int y,
+				int rows,
+				int cols)
+{
+	if (count <= 0 || !clipBox(window, &x, &y, &rows, &cols))
+		return;
+	int length = vertical ? rows : cols;
+	int bars = vertical ? cols : rows;
+	float *buckets = (float *)malloc(sizeof(float) * bars);
+	int *fill = (int *)malloc(sizeof(int) * bars);
+	char *glyphs = (char *)malloc(cols);
+	int used = seriesBuckets(values, count, buckets, bars);
+	if (!(min < max))
+	{
+		float lo;
+		seriesRange(buckets, used, &lo, &max);
+		min = 0;
+		if (max <= 0)
+			max = 1;
+	}
+	float scale = length / (max - min);
+	int b;
+	for (b = 0; b < bars; b++)
+	{
+		int n = b < used ? (int)((buckets[b] - min) * scale + 0.5f) : 0;
+		fill[b] = n < 0 ? 0 : n > length ? length : n;
+	}
+	color_t slot = windowPaletteSlot(window, color);
+	int i, j;
+	for (i = 0; i < rows; i++)
+	{
+		if (vertical)
+		{
+			int level = rows - i;
+			for (j = 0; j < cols; j++)
+				glyphs[j] = fill[j] >= level ? '#' : ' ';
+		}
+		else
+		{
+			memset(glyphs, '#', fill[i]);
+			memset(glyphs + fill[i], ' ', cols - fill[i]);
+		}
+		writeGlyphs(window, x + i, y, glyphs, cols, slot);
+	}
+	windowDamage(window, x, y, x + rows, y + cols);
+	free(buckets);
+	free(fill);
+	free(glyphs);
+}
+
+/**
+ * This function draws a grid of values as a heatmap, coloring the
+ * background of each cell by its value. A grid larger than the box is
+ * shrunk to it by averaging: each row of the box is the mean of the grid
+ * rows that fall on it, each shrunk to the width. A grid with fewer rows
+ * than the box only fills its first grid_rows rows. Values are spread over
+ * the ramp of colors from min to max, or over the grid's own range when
+ * max is not above min.
+ *
+ * @param window the window being drawn in
+ * @param values the grid, row after row
+ * @param grid_rows the number of rows in the grid
+ * @param grid_cols the number of values in a row of the grid
+ * @param min the value of the first ramp color
+ * @param max the value of the last ramp color
+ * @param ramp the colors, lowest first
+ * @param ramp_size the number of colors
+ * @param x the first row
+ * @param y the first column
+ * @param rows the number of rows
+ * @param cols the number of columns
+ */
+void windowHeatmap(window_t *window,
+				const float *values,
+				int grid_rows,
+				int grid_cols,
+				float min,
+				float max,
+				const color_value_t *ramp,
+				int ramp_size,
+				int x,
+				int y,
+				int rows,
+				int cols)
+{
+	if (grid_rows <= 0 || grid_cols <= 0 || ramp_size <= 0
+		|| !clipBox(window, &x, &y, &rows, &cols))
+		return;
+	if (rows > grid_rows)
+		rows = grid_rows;
+	chartRange(values, grid_rows * grid_cols, &min, &max);
+	background_t *slots = (background_t *)malloc(sizeof(background_t) * ramp_size);
+	float *buckets = (float *)malloc(sizeof(float) * cols);
+	float *sums = (float *)malloc(sizeof(float) * cols);
+	int k;
+	for (k = 0; k < ramp_size; k++)
+		slots[k] = windowPaletteSlotKeep(window, ramp[k], slots, k);
+	float scale = ramp_size / (max - min);
+	int i, j;
+	for (i = 0; i < rows; i++)
+	{
+		int start = (int)((long long)i * grid_rows / rows);
+		int end = (int)((long long)(i + 1) * grid_rows / rows);
+		int used = 0;
+		int g;
+		memset(sums, 0, sizeof(float) * cols);
+		for (g = start; g < end; g++)
+		{
+			used = seriesBuckets(values + (size_t)g * grid_cols, grid_cols, buckets, cols);
+			for (j = 0; j < used; j++)
+				sums[j] += buckets[j];
+		}
+		memset(window->contents[x + i] + y, ' ', cols);
+		background_t *row = window->backgrounds[x + i] + y;
+		for (j = 0; j < used; j++)
+		{
+			int level = (int)((sums[j] / (end - start) - min) * scale);
+			row[j] = slots[level < 0 ? 0 : level >= ramp_size ? ramp_size - 1 : level];
+		}
+		if (used < cols)
+			memset(row + used, window->background, cols - used);
+	}
+	windowDamage(window, x, y, x + rows, y + cols);
+	free(slots);
+	free(buckets);
+	free(sums);
+}
@@ -0,0 +1,103 @@
+#include "display.h"
+
+static const unsigned char ansi[16][3] = {
+	{0, 0, 0}, {205, 0, 0}, {0, 205, 0}, {205, 205, 0},
+	{0, 0, 238}, {205, 0, 205}, {0, 205, 205}, {229, 229, 229},
+	{127, 127, 127}, {255, 0, 0}, {0, 255, 0}, {255, 255, 0},
+	{92, 92, 255}, {255, 0, 255}, {0, 255, 255}, {255, 255, 255}
+};
+
+static int cubeLevel(int index)
+{
+	return index ? index * 40 + 55 : 0;
+}
+
+static int cubeIndex(int channel)
+{
+	if (channel < 48) return 0;
+	if (channel < 115) return 1;
+	return (channel - 35) / 40;
+}
+
+/**
+ * This function converts an indexed color to its xterm RGB value.
+ * RGB colors are returned as they are.
+ *
+ * @param value the color value
+ * @return the COLOR_RGB value
+ */
+color_value_t colorToRGB(color_value_t value)
+{
+	if (COLOR_IS_RGB(value))
+		return value;
+	value &= 0xff;
+	if (value < 16)
+		return COLOR_RGB(ansi[value][0], ansi[value][1], ansi[value][2]);
+	if (value < 232)
+	{
+		value -= 16;
+		return COLOR_RGB(cubeLevel(value / 36), cubeLevel((value / 6) % 6), cubeLevel(value % 6));
+	}
+	int level = (value - 232) * 10 + 8;
+	return COLOR_RGB(level, level, level);
+}
+
+/**
+ * This function measures how far apart two colors look, as the squared
+ * distance between their RGB values.
+ *
+ * @param a the first color value
+ * @param b the second color value
+ * @return the squared distance
+ */
+int colorDistance(color_value_t a, color_value_t b)
+{
+	a = colorToRGB(a);
+	b = colorToRGB(b);
+	int dr = (int)((a >> 16) & 0xff) - (int)((b >> 16) & 0xff);
+	int dg = (int)((a >> 8) & 0xff) - (int)((b >> 8) & 0xff);
+	int db = (int)(a & 0xff) - (int)(b & 0xff);
+	return dr * dr + dg * dg + db * db;
+}
+
+/**
+ * This function finds the color a terminal with the given color depth
+ * can show that is closest to a color value.
+ * Colors the terminal can already show are returned as they are.
+ *
+ * @param value the color value
+ * @param depth the COLOR_DEPTH_* of the terminal
+ * @return the closest color value the terminal can show
+ */
+color_value_t colorDegrade(color_value_t value, int depth)
+{
+	if (depth == COLOR_DEPTH_TRUE)
+		return value;
+	if (depth == COLOR_DEPTH_MONO)
+		return 0;
+	if (!COLOR_IS_RGB(value) && (value < 16 || depth == COLOR_DEPTH_256))
+		return value & 0xff;
+
+	int i;
+	if (depth == COLOR_DEPTH_16)
+	{
+		int best = 0;
+		for (i = 1; i < 16; i++)
+		{
+			if (colorDistance(i, value) < colorDistance(best, value))
+				best = i;
+		}
+		return best;
+	}
+
+	int r = (value >> 16) & 0xff;
+	int g = (value >> 8) & 0xff;
+	int b = value & 0xff;
+	color_value_t cube = 16 + 36 * cubeIndex(r) + 6 * cubeIndex(g) + cubeIndex(b);
+	int gray = ((r + g + b) / 3 - 3) / 10;
+	if (gray < 0) gray = 0;
+	if (gray > 23) gray = 23;
+	if (colorDistance(232 + gray, value) < colorDistance(cube, value))
+		return 232 + gray;
+	return cube;
+}
@@ -1,20 +1,24 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <ctype.h>
 #include <sys/ioctl.h>
-#include "display.h"
-
-#define CLEAR_STRING "\033[2J"
-
-#define TRUE 1
-#define FALSE 0
+#include "display_internal.h"
 
 static void windowRender(window_t *window);
 static void yankWindow(window_t *window);
 static char ** buildStringBlock(unsigned int rows, unsigned int cols);
 static color_t ** buildColorBlock(unsigned int rows, unsigned int cols, color_t color);
 static void freeDisplayContent(display_t* display);
+static void fillRect(window_t *window, int planes, char c, color_t color,
+				background_t background, int x0, int y0, int x1, int y1);
+static cell_t ** buildCellBlock(unsigned int rows, unsigned int cols, cell_t *cells);
+static char buildDisplayContent(display_t* display, int rows, int cols);
+static void paletteStore(window_t *window, int slot, color_value_t value);
+static void damageRect(display_t *display, int x0, int y0, int x1, int y1);
+static void releaseDamage(window_t *window);
+static void pickKernel(display_t* display);
 
 /**
  * This function builds a new display space.
@@ -30,29 +34,81 @@ static void freeDisplayContent(display_t* display);
 display_t *newDisplay(FILE *term,
 				int rows,
 				int cols)
+{
+	return newDisplayState(term, rows, cols, NULL);
+}
+
+/**
+ * This function builds a new display space whose record of what the
+ * terminal shows lives in a memory mapped state file.
+ * When the file holds a trusted state for this terminal, for example one
+ * left by a process that drew here before restarting, the screen is not
+ * cleared and only the cells that differ from it are sent.
+ * If the file cannot be mapped the display works as if made by newDisplay.
+ *
+ * @param term the terminal to display on
+ * @param rows the number of rows to display
+ * @param cols the number of columns to display
+ * @param path the state file, NULL for none
+ * @return the new display object
+ */
+display_t *newDisplayState(FILE *term,
+				int rows,
+				int cols,
+				const char *path)
+{
+	char valid;
+	display_t *display = displayCreate(term, rows, cols, path, &valid);
+	if (!valid)
+		fputs(display->profile->clear, display->term);
+	fprintf(display->term, "\033[%d;0H", rows + 1);
+	fputs(display->profile->cursor_hide, display->term);
+	fflush(display->term);
+	return display;
+}
+
+/**
+ * This function builds a display without sending anything to the
+ * terminal.
+ *
+ * @param term the terminal to display on
+ * @param rows the number of rows to display
+ * @param cols the number of columns to display
+ * @param path the state file, NULL for none
+ * @param valid set to whether the state file held what the terminal shows
+ * @return the new display object
+ */
+display_t *displayCreate(FILE *term,
+				int rows,
+				int cols,
+				const char *path,
+				char *valid)
 {
 	display_t *display = (display_t *)malloc(sizeof(display_t));
 	display->term = term;
-	display->current = buildStringBlock(rows, cols);
-	#ifdef DISPLAY_COLOR
-	display->current_color = buildColorBlock(rows, cols, WHITE);
+	display->state = NULL;
+	display->state_size = 0;
+	display->state_path = path != NULL ? strdup(path) : NULL;
+	display->screens = NULL;
 	display->default_color = WHITE;
-	#endif
-	#ifdef DISPLAY_BACKGROUND
-	display->current_background = (background_t **) buildColorBlock(rows, cols, -1);
 	display->default_background = BLACK;
-	#endif
-	display->dim.x = rows;
-	display->dim.y = cols;
+	display->profile = terminalDetect(&display->color_depth);
+	display->planes = FILL_COLOR | FILL_BACKGROUND;
+	display->kernel = NULL;
+	display->damage = NULL;
+	pickKernel(display);
+	display->out.data = NULL;
+	display->out.length = 0;
+	display->out.size = 0;
 	display->top_window = NULL;
 	display->hidden = FALSE;
 	display->bottom_window = NULL;
-	fprintf(display->term, CLEAR_STRING);
-	fprintf(display->term, "\033[%d;0H", rows + 1);
-	fprintf(display->term, "\033[?25l");
-	fflush(display->term);
-	display->dirty = TRUE;
+	display->sinks = NULL;
+	display->recorder = NULL;
+	display->dirty = FALSE;
+	display->updating = 0;
 	display->auto_size = FALSE;
+	*valid = buildDisplayContent(display, rows, cols);
 	return display;
 }
 
@@ -87,28 +143,35 @@ window_t *newWindow(display_t *display,
 	int dy = boarder ? dim_y + 2: dim_y;
 	window_t *window = (window_t *)malloc(sizeof(window_t));
 	window->contents = buildStringBlock(dx, dy);
-	#ifdef DISPLAY_COLOR
-	window->colors = buildColorBlock(dx, dy, WHITE);
-	#endif
-	#ifdef DISPLAY_BACKGROUND
-	window->backgrounds = (background_t **) buildColorBlock(dx, dy, BLACK);
-	#endif
+	window->attrs = (attr_t **) buildColorBlock(dx, dy, 0);
+	window->colors = buildColorBlock(dx, dy, PALETTE_COLOR);
+	window->backgrounds = (background_t **) buildColorBlock(dx, dy, PALETTE_BACKGROUND);
 	window->pos.x = px;
 	window->pos.y = py;
 	window->dim.x = dx;
 	window->dim.y = dy;
-	#ifdef DISPLAY_COLOR
-	window->color = RESET;
-	#endif
-	#ifdef DISPLAY_BACKGROUND
-	window->background = BLACK;
+	window->color = PALETTE_COLOR;
+	window->background = PALETTE_BACKGROUND;
 	window->setBack = FALSE;
-	#endif
+	window->attr = 0;
+	window->transparency = TRANSPARENT_NONE;
+	window->mask = NULL;
+	window->pad = NULL;
+	window->sent = NULL;
+	window->held_from.x = 0;
+	window->held_from.y = 0;
+	window->held_to = window->held_from;
 	window->hidden = FALSE;
 	window->display = display;
 	window->boarder = boarder;
 	window->next = NULL;
 
+	memset(window->palette.index_slot, 0, sizeof(window->palette.index_slot));
+	paletteStore(window, PALETTE_COLOR, RESET);
+	paletteStore(window, PALETTE_BACKGROUND, BLACK);
+	window->palette.count = PALETTE_BACKGROUND + 1;
+	window->palette.free_count = 0;
+
 	if (window->display->top_window == NULL)
 	{
 		window->last = NULL;
@@ -140,9 +203,10 @@ window_t *newWindow(display_t *display,
 			window->contents[0][i] = '-';
 			window->contents[dx-1][i] = '-';
 		}
+		windowColorBoarder(window, WHITE, BLACK);
 	}
 
-	window->display->dirty = TRUE;
+	windowDamage(window, 0, 0, dx, dy);
 	return window;
 }
 
@@ -169,10 +233,11 @@ void windowPrint(window_t *window,
 {
 	int i;
 	int d = window->boarder ? 1: 0;
+	int first = x + d;
 	for (i = 0; str[i] != '\0'; i++)
 	{
 	 	if (x + d >= window->dim.x - d)
-	 		return;
+	 		break;
 	 	if (isNotPrinted(str[i]) && i + y + d < window->dim.y - d)
 	 	{
 	 		if (str[i] == '\t')	
@@ -181,23 +246,17 @@ void windowPrint(window_t *window,
 	 			int end = ((pos + 8) / 8) * 8;
 	 			for (; i + y < end; y++) {
 	 				window->contents[x + d][i + y + d] = ' ';
-			 		#ifdef DISPLAY_COLOR
+	 				window->attrs[x + d][i + y + d] = window->attr;
 					window->colors[x + d][i + y + d] = window->color;
-					#endif
-					#ifdef DISPLAY_BACKGROUND
 					if (window->setBack)
 							window->backgrounds[x + d][i + y + d] = window->background;
-					#endif
 	 			}
 	 		}
 	 		window->contents[x + d][i + y + d] = str[i];
-	 		#ifdef DISPLAY_COLOR
+	 		window->attrs[x + d][i + y + d] = window->attr;
 			window->colors[x + d][i + y + d] = window->color;
-			#endif
-			#ifdef DISPLAY_BACKGROUND
 			if (window->setBack)
 					window->backgrounds[x + d][i + y + d] = window->background;
-			#endif
 	 	}
 	 	else
 	 	{
@@ -213,7 +272,7 @@ void windowPrint(window_t *window,
 	 		}
 	 	}
 	}
-	window->display->dirty = TRUE;
+	windowDamage(window, first, d, x + d + 1, window->dim.y - d);
 }
 
 /**
@@ -232,14 +291,10 @@ void windowPrintColor(window_t *window,
 				int x,
 				int y)
 {
-	#ifdef DISPLAY_COLOR
 	color_t orginal = window->color;
-	window->color = color;
-	#endif
+	window->color = windowPaletteSlot(window, color);
 	windowPrint(window, str, x, y);
-	#ifdef DISPLAY_COLOR
 	window->color = orginal;
-	#endif
 }
 
 void windowPrintBackground(window_t * window,
@@ -249,16 +304,58 @@ void windowPrintBackground(window_t * window,
 				int x,
 				int y)
 {
-	#ifdef DISPLAY_BACKGROUND
+	windowPrintValue(window, str, color, background, x, y);
+}
+
+/**
+ * This function prints a string with a color and background value.
+ * Either value can be an indexed color or a COLOR_RGB color.
+ *
+ * @param window the window being printed to
+ * @param str the string being printed
+ * @param color the color value being used
+ * @param background the background value being used
+ * @param x the start row
+ * @param y the start column
+ */
+void windowPrintValue(window_t *window,
+				char *str,
+				color_value_t color,
+				color_value_t background,
+				int x,
+				int y)
+{
+	color_t original_color = window->color;
+	window->color = windowPaletteSlot(window, color);
 	window->setBack = TRUE;
 	background_t original = window->background;
-	window->background = background;
-	#endif
-	windowPrintColor(window, str, color, x, y);
-	#ifdef DISPLAY_BACKGROUND
+	window->background = windowPaletteSlot(window, background);
+	windowPrint(window, str, x, y);
+	window->color = original_color;
 	window->background = original;
 	window->setBack = FALSE;
-	#endif
+}
+
+/**
+ * This function prints a string with text attributes such as ATTR_BOLD
+ * or ATTR_UNDERLINE.
+ *
+ * @param window the window being printed to
+ * @param str the string being printed
+ * @param attr the ATTR_* flags being used
+ * @param x the start row
+ * @param y the start column
+ */
+void windowPrintAttr(window_t *window,
+				char *str,
+				attr_t attr,
+				int x,
+				int y)
+{
+	attr_t original = window->attr;
+	window->attr = attr & ATTR_ALL;
+	windowPrint(window, str, x, y);
+	window->attr = original;
 }
 
 /**
@@ -275,19 +372,16 @@ void windowChar(window_t *window,
 				int x,
 				int y)
 {
-	window->display->dirty = TRUE;
 	int d = window->boarder ? 1: 0;
     x = x + d;
     y = y + d;
-    if (x > 0 && x < window->display->dim.x - d && y > 0 && y < window->display->dim.y)
+    if (x >= d && x < window->dim.x - d && y >= d && y < window->dim.y - d)
 	{
+		windowDamage(window, x, y, x + 1, y + 1);
     	window->contents[x][y] = c;
-    	#ifdef DISPLAY_COLOR
+    	window->attrs[x][y] = window->attr;
 		window->colors[x][y] = window->color;
-		#endif
-		#ifdef DISPLAY_BACKGROUND
 		window->backgrounds[x][y] = window->background;
-		#endif
 	}
 }
 
@@ -306,58 +400,204 @@ void windowCharColor(window_t *window,
 				int x,
 				int y)
 {
-	#ifdef DISPLAY_COLOR
 	color_t original = window->color;
-	window->color = color;
-	#endif
+	window->color = windowPaletteSlot(window, color);
 	windowChar(window, c, x, y);
-	#ifdef DISPLAY_COLOR
 	window->color = original;
-	#endif
 }
 
+/**
+ * This function sets the default text color of a window.
+ * Every cell printed with the default color follows it, so this is a single
+ * palette write no matter how large the window is.
+ *
+ * @param window the window being recolored
+ * @param color the new default color
+ */
 void windowSetColor(window_t *window, color_t color)
 {
-	#ifdef DISPLAY_COLOR
-	color_t original = window->color;
-	int d = window->boarder ? 1 : 0;
+	windowSetColorValue(window, color);
+}
+
+/**
+ * This function sets the default background of a window.
+ * Every cell printed with the default background follows it.
+ *
+ * @param window the window being recolored
+ * @param background the new default background
+ */
+void windowSetBackground(window_t *window, background_t background)
+{
+	windowSetBackgroundValue(window, background);
+}
+
+/**
+ * This function sets the default text color of a window to an indexed
+ * or COLOR_RGB color.
+ *
+ * @param window the window being recolored
+ * @param color the new default color value
+ */
+void windowSetColorValue(window_t *window, color_value_t color)
+{
+	if (window->palette.entries[PALETTE_COLOR] == color)
+		return;
+	paletteStore(window, PALETTE_COLOR, color);
+	windowDamage(window, 0, 0, window->dim.x, window->dim.y);
+}
+
+/**
+ * This function sets the default background of a window to an indexed
+ * or COLOR_RGB color.
+ *
+ * @param window the window being recolored
+ * @param background the new default background value
+ */
+void windowSetBackgroundValue(window_t *window, color_value_t background)
+{
+	if (window->palette.entries[PALETTE_BACKGROUND] == background)
+		return;
+	paletteStore(window, PALETTE_BACKGROUND, background);
+	windowDamage(window, 0, 0, window->dim.x, window->dim.y);
+}
+
+/**
+ * This function finds the palette slot holding a color value, handing out
+ * a new slot the first time a color is used.
+ * When every slot has been handed out, the ones no cell holds any more are
+ * given back by a sweep; only if none are free is the slot with the
+ * closest color reused.
+ *
+ * @param window the window owning the palette
+ * @param value the color value
+ * @return the palette slot of the color
+ */
+color_t windowPaletteSlot(window_t *window, color_value_t value)
+{
+	return windowPaletteSlotKeep(window, value, NULL, 0);
+}
+
+/**
+ * This function gives back the palette slots that no cell, pen or kept
+ * slot holds, so they can be handed out again.
+ *
+ * @param window the window owning the palette
+ * @param keep slots the caller holds but has not written yet
+ * @param keep_count the number of kept slots
+ */
+static void paletteSweep(window_t *window, const unsigned char *keep, int keep_count)
+{
+	palette_t *palette = &window->palette;
+	unsigned char live[PALETTE_SIZE];
+	memset(live, 0, sizeof(live));
+	live[PALETTE_COLOR] = TRUE;
+	live[PALETTE_BACKGROUND] = TRUE;
+	live[window->color] = TRUE;
+	live[window->background] = TRUE;
 	int i, j;
-	for (i = d; i < window->dim.x - d; i++)
+	for (i = 0; i < keep_count; i++)
+		live[keep[i]] = TRUE;
+	for (i = 0; i < window->dim.x; i++)
 	{
-		for (j = d; j < window->dim.y - d; j++)
+		for (j = 0; j < window->dim.y; j++)
 		{
-			if (window->colors[i][j] == original)
-			{
-				window->colors[i][j] = color;
-			}
+			live[window->colors[i][j]] = TRUE;
+			live[window->backgrounds[i][j]] = TRUE;
 		}
 	}
-	window->color = color;
-	window->display->dirty = TRUE;
-	#endif
+	if (window->pad != NULL)
+		padMarkSlots(window->pad, live);
+
+	palette->free_count = 0;
+	for (i = PALETTE_BACKGROUND + 1; i < palette->count; i++)
+	{
+		if (live[i])
+			continue;
+		color_value_t value = palette->entries[i];
+		if (!COLOR_IS_RGB(value) && palette->index_slot[value & 0xff] == i)
+			palette->index_slot[value & 0xff] = 0;
+		palette->entries[i] = COLOR_NONE;
+		palette->free_slots[palette->free_count++] = i;
+	}
 }
 
-void windowSetBackground(window_t *window, background_t background)
+/**
+ * This function is windowPaletteSlot for callers that hold slots they
+ * have not written into cells yet, which a sweep must not give back.
+ *
+ * @param window the window owning the palette
+ * @param value the color value
+ * @param keep the slots held by the caller
+ * @param keep_count the number of held slots
+ * @return the palette slot of the color
+ */
+color_t windowPaletteSlotKeep(window_t *window, color_value_t value,
+				const unsigned char *keep, int keep_count)
 {
-	#ifdef DISPLAY_BACKGROUND
-	background_t original = window->background;
-	int d = window->boarder ? 1 : 0;
-	int i, j;
-	for (i = d; i < window->dim.x - d; i++)
+	palette_t *palette = &window->palette;
+	int i;
+	if (!COLOR_IS_RGB(value))
+	{
+		value &= 0xff;
+		if (palette->index_slot[value])
+			return palette->index_slot[value];
+	}
+	else
+	{
+		for (i = PALETTE_BACKGROUND + 1; i < palette->count; i++)
+		{
+			if (palette->entries[i] == value)
+				return i;
+		}
+	}
+
+	if (palette->count < PALETTE_SIZE)
+		i = palette->count++;
+	else
 	{
-		for (j = d; j < window->dim.y - d; j++)
+		if (palette->free_count == 0)
+			paletteSweep(window, keep, keep_count);
+		if (palette->free_count == 0)
 		{
-			if (window->backgrounds[i][j] == original)
+			int best = PALETTE_BACKGROUND + 1;
+			for (i = best + 1; i < PALETTE_SIZE; i++)
 			{
-				window->backgrounds[i][j] = background;
+				if (colorDistance(palette->entries[i], value)
+						< colorDistance(palette->entries[best], value))
+					best = i;
 			}
+			return best;
 		}
+		i = palette->free_slots[--palette->free_count];
 	}
-	window->background = background;
-	window->display->dirty = TRUE;
-	#endif
+	paletteStore(window, i, value);
+	if (!COLOR_IS_RGB(value))
+		palette->index_slot[value] = i;
+	return i;
+}
+
+/**
+ * This function sets the text attributes used by later prints.
+ *
+ * @param window the window being changed
+ * @param attr the ATTR_* flags
+ */
+void windowSetAttr(window_t *window, attr_t attr)
+{
+	window->attr = attr & ATTR_ALL;
 }
 
+/**
+ * This function paints the background of the content cells from
+ * (start_x, start_y) up to but not including (end_x, end_y).
+ *
+ * @param window the window being painted
+ * @param background the background being used
+ * @param start_x the first row
+ * @param start_y the first column
+ * @param end_x the row after the last row
+ * @param end_y the column after the last column
+ */
 void windowDrawBackground(window_t *window,
 				background_t background,
 				int start_x,
@@ -365,18 +605,56 @@ void windowDrawBackground(window_t *window,
 				int end_x,
 				int end_y)
 {
-	#ifdef DISPLAY_BACKGROUND
+	windowFill(window, FILL_BACKGROUND, '\0', RESET, background,
+				start_x, start_y, end_x - start_x, end_y - start_y);
+}
+
+/**
+ * This function fills a rectangle of a window's content with a glyph,
+ * a color, a background or any combination of them.
+ * The planes argument selects what is written (FILL_GLYPH, FILL_COLOR,
+ * FILL_BACKGROUND, FILL_ATTR); the other planes are left untouched.
+ * FILL_ATTR writes the attributes set with windowSetAttr.
+ * The rectangle is clipped to the content area of the window.
+ *
+ * @param window the window being filled
+ * @param planes the FILL_* flags of the planes being written
+ * @param c the char being written
+ * @param color the color being written
+ * @param background the background being written
+ * @param x the first row
+ * @param y the first column
+ * @param rows the number of rows
+ * @param cols the number of columns
+ */
+void windowFill(window_t *window,
+				int planes,
+				char c,
+				color_t color,
+				background_t background,
+				int x,
+				int y,
+				int rows,
+				int cols)
+{
 	int d = window->boarder ? 1: 0;
-	int i, j;
-	for (i = start_x + d; i < end_x + d && i < window->dim.x - d; i++)
-	{
-		for (j = start_y + d; j < end_y + d && i < window->dim.y - d; j++)
-		{
-			window->backgrounds[i][j] = background;
-		}
-	}
-	window->display->dirty = TRUE;
-	#endif
+	int x0 = x + d;
+	int y0 = y + d;
+	int x1 = x0 + rows;
+	int y1 = y0 + cols;
+	if (x0 < d) x0 = d;
+	if (y0 < d) y0 = d;
+	if (x1 > window->dim.x - d) x1 = window->dim.x - d;
+	if (y1 > window->dim.y - d) y1 = window->dim.y - d;
+	if (x0 >= x1 || y0 >= y1)
+		return;
+	color_t color_slot = 0;
+	background_t background_slot = 0;
+	if (planes & FILL_COLOR)
+		color_slot = windowPaletteSlot(window, color);
+	if (planes & FILL_BACKGROUND)
+		background_slot = windowPaletteSlotKeep(window, background, &color_slot, 1);
+	fillRect(window, planes, c, color_slot, background_slot, x0, y0, x1, y1);
 }
 
 void windowSetBoarder(window_t * window,
@@ -392,22 +670,14 @@ void windowSetBoarder(window_t * window,
 	int dx = window->dim.x;
 	int dy = window->dim.y;
 
+	fillRect(window, FILL_GLYPH, horizontal, RESET, BLACK, 0, 1, 1, dy - 1);
+	fillRect(window, FILL_GLYPH, horizontal, RESET, BLACK, dx - 1, 1, dx, dy - 1);
+	fillRect(window, FILL_GLYPH, vertical, RESET, BLACK, 1, 0, dx - 1, 1);
+	fillRect(window, FILL_GLYPH, vertical, RESET, BLACK, 1, dy - 1, dx - 1, dy);
 	window->contents[0][0] = corner;
 	window->contents[0][dy-1] = corner;
 	window->contents[dx-1][0] = corner;
 	window->contents[dx-1][dy-1] = corner;
-
-	int i;
-	for (i = 1; i < dx - 1; i++)
-	{
-		window->contents[i][0] = vertical;
-		window->contents[i][dy-1] = vertical;
-	}
-	for (i = 1; i < dy - 1; i++)
-	{
-		window->contents[0][i] = horizontal;
-		window->contents[dx-1][i] = horizontal;
-	}
 	windowColorBoarder(window, color, background);
 }
 
@@ -417,30 +687,15 @@ void windowColorBoarder(window_t * window,
 {
 	if (!window->boarder)
 			return;
-	int i;
-	for (i = 0; i < window->dim.x; i++)
-	{
-		#ifdef DISPLAY_COLOR
-		window->colors[i][0] = color;
-		window->colors[i][window->dim.y - 1] = color;
-		#endif
-		#ifdef DISPLAY_BACKGROUND
-		window->backgrounds[i][0] = background;
-		window->backgrounds[i][window->dim.y - 1] = background;
-		#endif
-	}
-	for (i = 0; i < window->dim.y; i++)
-	{
-		#ifdef DISPLAY_COLOR
-		window->colors[0][i] = color;
-		window->colors[window->dim.x - 1][i] = color;
-		#endif
-		#ifdef DISPLAY_BACKGROUND
-		window->backgrounds[0][i] = background;
-		window->backgrounds[window->dim.x - 1][i] = background;
-		#endif
-	}
-	window->display->dirty = TRUE;
+	int dx = window->dim.x;
+	int dy = window->dim.y;
+	int planes = FILL_COLOR | FILL_BACKGROUND;
+	color_t c = windowPaletteSlot(window, color);
+	background_t b = windowPaletteSlotKeep(window, background, &c, 1);
+	fillRect(window, planes, '\0', c, b, 0, 0, 1, dy);
+	fillRect(window, planes, '\0', c, b, dx - 1, 0, dx, dy);
+	fillRect(window, planes, '\0', c, b, 1, 0, dx - 1, 1);
+	fillRect(window, planes, '\0', c, b, 1, dy - 1, dx - 1, dy);
 }
 
 /**
@@ -451,65 +706,274 @@ void windowColorBoarder(window_t * window,
 void windowClear(window_t *window)
 {
 	int d = window->boarder ? 1: 0;
+	color_t color = window->color;
+	background_t background = window->background;
+	fillRect(window, FILL_ALL, '\0', color, background,
+				d, d, window->dim.x - d, window->dim.y - d);
+}
+
+/**
+ * This function creates a window without a boarder that holds cells as
+ * they are sent to the terminal instead of palette slots, such as the
+ * cells of a replay. Cells are written to it with windowPutCells and are
+ * shown as they are, so it takes any number of colors without touching
+ * its palette.
+ *
+ * @param display the display the window belongs to
+ * @param pos_x the window row
+ * @param pos_y the window column
+ * @param dim_x the number of rows
+ * @param dim_y the number of columns
+ * @return the new window
+ */
+window_t *newCellWindow(display_t *display,
+				int pos_x,
+				int pos_y,
+				int dim_x,
+				int dim_y)
+{
+	window_t *window = newWindow(display, 0, pos_x, pos_y, dim_x, dim_y);
+	cell_t *block = (cell_t *)calloc((size_t)dim_x * dim_y, sizeof(cell_t));
+	window->sent = (cell_t **)malloc(sizeof(cell_t *) * dim_x);
 	int i, j;
-	for (i = d; i < window->dim.x - d; i++)
+	for (i = 0; i < dim_x; i++)
+	{
+		window->sent[i] = block + (size_t)i * dim_y;
+		for (j = 0; j < dim_y; j++)
+			window->sent[i][j].color[2] = RESET;
+	}
+	return window;
+}
+
+/**
+ * This function writes cells, such as the ones from a replay, straight
+ * into a window. A window made with newCellWindow keeps them as they are;
+ * any other window adds their colors to its palette.
+ *
+ * @param window the window being written
+ * @param cells the cells
+ * @param count the number of cells
+ * @param x the row
+ * @param y the first column
+ */
+void windowPutCells(window_t *window,
+				const cell_t *cells,
+				int count,
+				int x,
+				int y)
+{
+	int d = window->boarder ? 1: 0;
+	x += d;
+	y += d;
+	if (x < d || x >= window->dim.x - d)
+		return;
+	if (window->sent != NULL)
 	{
-		for (j = d; j < window->dim.y - d; j++)
+		if (y < 0)
 		{
-			window->contents[i][j] = '\0';
-			#ifdef DISPLAY_COLOR
-			window->colors[i][j] = window->color;
-			#endif
-			#ifdef DISPLAY_BACKGROUND
-			window->backgrounds[i][j] = window->background;
-			#endif
+			cells -= y;
+			count += y;
+			y = 0;
 		}
+		if (count > window->dim.y - y)
+			count = window->dim.y - y;
+		if (count <= 0)
+			return;
+		memcpy(window->sent[x] + y, cells, sizeof(cell_t) * count);
+		int k;
+		for (k = 0; k < count; k++)
+			window->contents[x][y + k] = cells[k].data;
+		windowDamage(window, x, y, x + 1, y + count);
+		return;
+	}
+	int k;
+	for (k = 0; k < count && y + k < window->dim.y - d; k++)
+	{
+		if (y + k < d)
+			continue;
+		const cell_t *cell = &cells[k];
+		window->contents[x][y + k] = cell->data;
+		window->attrs[x][y + k] = cell->attr & ATTR_ALL;
+		color_value_t color = cell->color[2];
+		if (cell->attr & CELL_COLOR_RGB)
+			color = COLOR_RGB(cell->color[0], cell->color[1], cell->color[2]);
+		window->colors[x][y + k] = windowPaletteSlot(window, color);
+		color_value_t background = cell->background[2];
+		if (cell->attr & CELL_BACKGROUND_RGB)
+			background = COLOR_RGB(cell->background[0], cell->background[1], cell->background[2]);
+		window->backgrounds[x][y + k] = windowPaletteSlot(window, background);
 	}
-	window->display->dirty = TRUE;
+	windowDamage(window, x, y, x + 1, y + k);
 }
 
 void windowSetHide(window_t *window, char hidden)
 {
+	if (window->hidden == hidden)
+		return;
 	window->hidden = hidden;
-	window->display = TRUE;
+	damageRect(window->display, window->pos.x, window->pos.y,
+				window->pos.x + window->dim.x, window->pos.y + window->dim.y);
 }
 
-void displaySetHide(display_t *display, char hidden)
+/**
+ * This function sets which cells of a window let the windows under it
+ * show through.
+ * TRANSPARENT_UNWRITTEN makes cells that were never written (or cleared)
+ * see through, and TRANSPARENT_MASK the cells set with windowSetMask.
+ * Windows without either stay fully opaque, which composes fastest.
+ *
+ * @param window the window
+ * @param transparency the TRANSPARENT_* flags
+ */
+void windowSetTransparency(window_t *window, int transparency)
+{
+	if (window->transparency == transparency)
+		return;
+	if ((transparency & TRANSPARENT_MASK) && window->mask == NULL)
+		window->mask = buildColorBlock(window->dim.x, (window->dim.y + 7) / 8, 0);
+	window->transparency = transparency;
+	windowDamage(window, 0, 0, window->dim.x, window->dim.y);
+}
+
+/**
+ * This function marks a rectangle of a window's content as see through or
+ * not in its transparency mask, and turns the mask on.
+ * The rectangle is clipped to the content area of the window.
+ *
+ * @param window the window
+ * @param transparent TRUE to see through the rectangle, FALSE to cover
+ * @param x the first row
+ * @param y the first column
+ * @param rows the number of rows
+ * @param cols the number of columns
+ */
+void windowSetMask(window_t *window,
+				char transparent,
+				int x,
+				int y,
+				int rows,
+				int cols)
 {
-	if (hidden && !display->hidden)
+	windowSetTransparency(window, window->transparency | TRANSPARENT_MASK);
+	int d = window->boarder ? 1: 0;
+	int x0 = x + d;
+	int y0 = y + d;
+	int x1 = x0 + rows;
+	int y1 = y0 + cols;
+	if (x0 < d) x0 = d;
+	if (y0 < d) y0 = d;
+	if (x1 > window->dim.x - d) x1 = window->dim.x - d;
+	if (y1 > window->dim.y - d) y1 = window->dim.y - d;
+	if (x0 >= x1 || y0 >= y1)
+		return;
+	int i, j;
+	for (i = x0; i < x1; i++)
 	{
-		int i, j;
-		for (i = 0; i < display->dim.x; i++)
+		unsigned char *bits = window->mask[i];
+		for (j = y0; j < y1; j++)
 		{
-			for (j = 0; j < display->dim.y; j++)
-				{
-					display->current[i][j] = '\0';
-					#ifdef DISPLAY_COLOR
-					display->current_color[i][j] = WHITE;
-					#endif
-					#ifdef DISPLAY_BACKGROUND
-					display->current_background[i][j] = -1;
-					#endif
-				}
+			if (transparent)
+				bits[j >> 3] |= 1 << (j & 7);
+			else
+				bits[j >> 3] &= ~(1 << (j & 7));
 		}
-		fprintf(display->term, CLEAR_STRING);
+	}
+	windowDamage(window, x0, y0, x1, y1);
+}
+
+void displaySetHide(display_t *display, char hidden)
+{
+	// a page is hidden by hiding its set, so the terminal is handed back
+	// whole rather than left showing a page that no longer draws
+	if (display->screens != NULL)
+	{
+		if (!hidden)
+			screenSetShow(display->screens, display);
+		else if (display->screens->active == display)
+			screenSetHide(display->screens);
+		return;
+	}
+	if (hidden && !display->hidden && display->state != NULL)
+	{
+		fprintf(display->term, "\033[%d;1H", display->dim.x + 1);
+		fputs(display->profile->cursor_show, display->term);
+		fflush(display->term);
+	}
+	else if (!hidden && display->hidden && display->state != NULL)
+	{
+		fputs(display->profile->cursor_hide, display->term);
+		damageRect(display, 0, 0, display->dim.x, display->dim.y);
+	}
+	else if (hidden && !display->hidden)
+	{
+		memset(display->current[0], 0,
+				sizeof(cell_t) * display->dim.x * display->dim.y);
+		fputs(display->profile->clear, display->term);
 		fprintf(display->term, "\033[1;1H");
-		fprintf(display->term, "\033[?25h");
+		fputs(display->profile->cursor_show, display->term);
 		fprintf(display->term, "\1");
 		fflush(display->term);
 	}
 	else if (!hidden && display->hidden)
 	{
-		fprintf(display->term, CLEAR_STRING);
+		fputs(display->profile->clear, display->term);
 		//fprintf(display->term, "\033[%d;0H", display->dim.x + 1);
-		fprintf(display->term, "\033[?25l");
+		fputs(display->profile->cursor_hide, display->term);
 		//fprintf(display->term, "\1");
 		//fflush(display->term);
-		display->dirty = TRUE;
+		damageRect(display, 0, 0, display->dim.x, display->dim.y);
 	}
 	display->hidden = hidden;
 }
 
+/**
+ * This function swaps one color value for another across every window of
+ * a display, including the window defaults.
+ * Only the palettes are touched so the cost does not depend on window size.
+ *
+ * @param display the display being recolored
+ * @param from the color value being replaced
+ * @param to the new color value
+ */
+void displayRemapColor(display_t *display, color_value_t from, color_value_t to)
+{
+	if (from == to)
+		return;
+	if (display->default_color == from)
+	{
+		display->default_color = to;
+		damageRect(display, 0, 0, display->dim.x, display->dim.y);
+	}
+	if (display->default_background == from)
+	{
+		display->default_background = to;
+		damageRect(display, 0, 0, display->dim.x, display->dim.y);
+	}
+
+	window_t *window;
+	for (window = display->bottom_window; window != NULL; window = window->next)
+	{
+		palette_t *palette = &window->palette;
+		char changed = FALSE;
+		int i;
+		for (i = 0; i < palette->count; i++)
+		{
+			if (palette->entries[i] != from)
+				continue;
+			paletteStore(window, i, to);
+			changed = TRUE;
+			if (i <= PALETTE_BACKGROUND)
+				continue;
+			if (!COLOR_IS_RGB(from) && palette->index_slot[from & 0xff] == i)
+				palette->index_slot[from & 0xff] = 0;
+			if (!COLOR_IS_RGB(to) && !palette->index_slot[to & 0xff])
+				palette->index_slot[to & 0xff] = i;
+		}
+		if (changed)
+			windowDamage(window, 0, 0, window->dim.x, window->dim.y);
+	}
+}
+
 
 /**
  * This function sets the given window to the top of the window stack
@@ -525,7 +989,7 @@ void setTopWindow(window_t *window)
 	window->last = window->display->top_window;
 	window->display->top_window->next = window;
 	window->display->top_window = window;
-	window->display->dirty = TRUE;
+	windowDamage(window, 0, 0, window->dim.x, window->dim.y);
 }
 
 /**
@@ -535,26 +999,31 @@ void setTopWindow(window_t *window)
  */
 void freeWindow(window_t *window)
 {
+	windowDamage(window, 0, 0, window->dim.x, window->dim.y);
+	releaseDamage(window);
 	yankWindow(window);
 	int i = 0;
 	for (i = 0; i < window->dim.x; i++)
 	{
 		free(window->contents[i]);
-		#ifdef DISPLAY_COLOR
+		free(window->attrs[i]);
 		free(window->colors[i]);
-		#endif
-		#ifdef DISPLAY_BACKGROUND
 		free(window->backgrounds[i]);
-		#endif
+		if (window->mask != NULL)
+			free(window->mask[i]);
 	}
 	free(window->contents);
-	#ifdef DISPLAY_COLOR
+	free(window->mask);
+	free(window->attrs);
 	free(window->colors);
-	#endif
-	#ifdef DISPLAY_BACKGROUND
 	free(window->backgrounds);
-	#endif
-	window->display->dirty = TRUE;
+	if (window->pad != NULL)
+		freePad(window->pad);
+	if (window->sent != NULL)
+	{
+		free(window->sent[0]);
+		free(window->sent);
+	}
 	free(window);
 }
 
@@ -572,63 +1041,33 @@ void freeDisplay(display_t *display)
 		freeWindow(current);
 	}
 
-	freeDisplayContent(display);
-
-	fprintf(display->term, CLEAR_STRING);
-	fprintf(display->term, "\033[1;1H");
-	fprintf(display->term, "\033[?25h");
-
-	free(display);
-}
-
-static struct char_struct {
-	char data;
-	#ifdef DISPLAY_COLOR
-	color_t color;
-	#endif
-	#ifdef DISPLAY_BACKGROUND
-	background_t background;
-	#endif
-};
-
-static struct char_struct renderPoint(display_t* display, window_t * window, int x, int y)
-{
-	struct char_struct char_data;
-	char_data.data = ' ';
-	#ifdef DISPLAY_COLOR
-	char_data.color = display->default_color;
-	#endif
-	#ifdef DISPLAY_BACKGROUND
-	char_data.background = display->default_background;
-	#endif
-
-	if (window == NULL) return char_data;
-
-	window_t *current;
-	for (current = window; current != NULL; current = current->next)
+	if (display->screens != NULL)
 	{
-		if(!window->hidden)
+		screenSetRemovePage(display->screens, display);
+	}
+	else
+	{
+		if (display->state != NULL)
 		{
-			int i = x - current->pos.x;
-			if (x >= 0 && x < current->display->dim.x && i >= 0 && i < current->dim.x)
-			{
-				int j = y - current->pos.y;
-				if (y >= 0 && y < current->display->dim.y && j >= 0 && j < current->dim.y)
-				{
-					char_data.data = current->contents[i][j];
-					#ifdef DISPLAY_COLOR
-					char_data.color = current->colors[i][j];
-					#endif
-					#ifdef DISPLAY_BACKGROUND
-					char_data.background = current->backgrounds[i][j];
-					#endif
-				}
-				
-			}
+			fprintf(display->term, "\033[%d;1H", display->dim.x + 1);
 		}
+		else
+		{
+			fputs(display->profile->clear, display->term);
+			fprintf(display->term, "\033[1;1H");
+		}
+		fputs(display->profile->cursor_show, display->term);
+		fflush(display->term);
 	}
 
-	return char_data;
+	while (display->sinks != NULL)
+		displayRemoveSink(display, display->sinks);
+	displayStopRecording(display);
+	freeDisplayContent(display);
+	freeOutput(&display->out);
+	free(display->state_path);
+
+	free(display);
 }
 
 /**
@@ -697,46 +1136,248 @@ color_t ** buildColorBlock(unsigned int x, unsigned int y, color_t color)
 	return data;
 }
 
-static void freeDisplayContent(display_t* display)
+/**
+ * This is the rectangle fill engine behind the window fill functions.
+ * The rectangle is in raw window coordinates (boarder included) and
+ * covers rows x0 to x1 and columns y0 to y1, end exclusive.
+ * Every plane is written a whole row at a time so the stores run at
+ * memset speed.
+ *
+ * @param window the window being filled
+ * @param planes the FILL_* flags of the planes being written
+ * @param c the char being written
+ * @param color the color being written
+ * @param background the background being written
+ * @param x0 the first row
+ * @param y0 the first column
+ * @param x1 the row after the last row
+ * @param y1 the column after the last column
+ */
+static void fillRect(window_t *window,
+				int planes,
+				char c,
+				color_t color,
+				background_t background,
+				int x0,
+				int y0,
+				int x1,
+				int y1)
 {
+	if (x0 >= x1 || y0 >= y1)
+		return;
+	size_t n = (size_t)(y1 - y0);
 	int i;
-	for (i = 0; i < display->dim.x; i++)
+	if (planes & FILL_GLYPH)
 	{
-		free(display->current[i]);
-		#ifdef DISPLAY_COLOR
-		free(display->current_color[i]);
-		#endif
-		#ifdef DISPLAY_BACKGROUND
-		free(display->current_background[i]);
-		#endif
+		for (i = x0; i < x1; i++)
+			memset(window->contents[i] + y0, c, n);
 	}
-	free(display->current);
-	#ifdef DISPLAY_COLOR
-	free(display->current_color);
-	#endif
-	#ifdef DISPLAY_BACKGROUND
-	free(display->current_background);
-	#endif
+	if (planes & FILL_ATTR)
+	{
+		for (i = x0; i < x1; i++)
+			memset(window->attrs[i] + y0, window->attr, n);
+	}
+	if (planes & FILL_COLOR)
+	{
+		for (i = x0; i < x1; i++)
+			memset(window->colors[i] + y0, color, n);
+	}
+	if (planes & FILL_BACKGROUND)
+	{
+		for (i = x0; i < x1; i++)
+			memset(window->backgrounds[i] + y0, background, n);
+	}
+	windowDamage(window, x0, y0, x1, y1);
 }
 
-void displaySetSize(display_t* display, int rows, int cols)
+/**
+ * This function marks a rectangle of the display as needing to be redrawn.
+ * The rectangle is in display coordinates, end exclusive, and each row
+ * keeps a single span of damaged columns.
+ *
+ * @param display the display being damaged
+ * @param x0 the first row
+ * @param y0 the first column
+ * @param x1 the row after the last row
+ * @param y1 the column after the last column
+ */
+static void damageRect(display_t *display,
+				int x0,
+				int y0,
+				int x1,
+				int y1)
 {
-	if (rows == display->dim.x && cols == display->dim.y)
+	if (x0 < 0) x0 = 0;
+	if (y0 < 0) y0 = 0;
+	if (x1 > display->dim.x) x1 = display->dim.x;
+	if (y1 > display->dim.y) y1 = display->dim.y;
+	if (x0 >= x1 || y0 >= y1)
 		return;
+	int i;
+	for (i = x0; i < x1; i++)
+	{
+		span_t *span = &display->damage[i];
+		if (span->start >= span->end)
+		{
+			span->start = y0;
+			span->end = y1;
+			continue;
+		}
+		if (y0 < span->start) span->start = y0;
+		if (y1 > span->end) span->end = y1;
+	}
+	display->dirty = TRUE;
+}
 
-	freeDisplayContent(display);
+/**
+ * This function damages a rectangle given in raw window coordinates.
+ * Hidden windows do not show, so their changes do not damage anything.
+ * During an update the damage is only added to the window's held
+ * rectangle, which displayCommitUpdate hands to the display once.
+ *
+ * @param window the window that changed
+ * @param x0 the first row
+ * @param y0 the first column
+ * @param x1 the row after the last row
+ * @param y1 the column after the last column
+ */
+void windowDamage(window_t *window,
+				int x0,
+				int y0,
+				int x1,
+				int y1)
+{
+	if (window->hidden)
+		return;
+	if (window->display->updating)
+	{
+		if (window->held_from.x >= window->held_to.x)
+		{
+			window->held_from.x = x0;
+			window->held_from.y = y0;
+			window->held_to.x = x1;
+			window->held_to.y = y1;
+			return;
+		}
+		if (x0 < window->held_from.x) window->held_from.x = x0;
+		if (y0 < window->held_from.y) window->held_from.y = y0;
+		if (x1 > window->held_to.x) window->held_to.x = x1;
+		if (y1 > window->held_to.y) window->held_to.y = y1;
+		return;
+	}
+	damageRect(window->display,
+				window->pos.x + x0, window->pos.y + y0,
+				window->pos.x + x1, window->pos.y + y1);
+}
+
+/**
+ * This function hands the damage a window held during an update to the
+ * display.
+ *
+ * @param window the window
+ */
+static void releaseDamage(window_t *window)
+{
+	if (window->held_from.x >= window->held_to.x)
+		return;
+	if (!window->hidden)
+		damageRect(window->display,
+					window->pos.x + window->held_from.x, window->pos.y + window->held_from.y,
+					window->pos.x + window->held_to.x, window->pos.y + window->held_to.y);
+	window->held_to.x = window->held_from.x;
+}
+
+/**
+ * This function builds a 2D block of cells in one allocation, with the
+ * row pointers in front of the cells. Every cell starts zeroed, which
+ * never matches a rendered cell.
+ * When cells are given only the row pointers are allocated.
+ *
+ * @param x the x size
+ * @param y the y size
+ * @param cells the cells to point into, NULL to allocate them
+ * @return the 2D cell array
+ */
+static cell_t ** buildCellBlock(unsigned int x, unsigned int y, cell_t *cells)
+{
+	cell_t ** data;
+	if (cells == NULL)
+	{
+		data = (cell_t **)calloc(1, sizeof(cell_t *) * (x + 1) + sizeof(cell_t) * x * y);
+		cells = (cell_t *)(data + x + 1);
+	}
+	else
+	{
+		data = (cell_t **)malloc(sizeof(cell_t *) * (x + 1));
+	}
+	int i;
+	for (i = 0; i < x; i++)
+	{
+		data[i] = cells + (size_t)i * y;
+	}
+	data[x] = cells;
+	return data;
+}
+
+/**
+ * This function writes a palette slot, keeping the copy degraded to the
+ * color depth of the display in step.
+ *
+ * @param window the window owning the palette
+ * @param slot the palette slot
+ * @param value the color value
+ */
+static void paletteStore(window_t *window, int slot, color_value_t value)
+{
+	window->palette.entries[slot] = value;
+	window->palette.terminal[slot] = colorDegrade(value, window->display->color_depth);
+}
+
+/**
+ * This function builds the known terminal state, damage and scratch row of
+ * a display and damages the whole display.
+ *
+ * @param display the display data
+ * @param rows the number of rows
+ * @param cols the number of columns
+ * @return TRUE when the state came from a trusted state file
+ */
+static char buildDisplayContent(display_t* display, int rows, int cols)
+{
+	char valid = FALSE;
+	cell_t *cells = NULL;
+	if (display->state_path != NULL)
+		cells = stateAttach(display, rows, cols, &valid);
 
 	display->dim.x = rows;
 	display->dim.y = cols;
-	display->dirty = TRUE;
+	display->current = buildCellBlock(rows, cols, cells);
+	display->damage = (span_t *)calloc(rows, sizeof(span_t));
+	display->next = (cell_t *)malloc(sizeof(cell_t) * (cols + 1));
+	memset(&display->scroll, 0, sizeof(scroll_t));
+	damageRect(display, 0, 0, rows, cols);
+	return valid;
+}
+
+static void freeDisplayContent(display_t* display)
+{
+	free(display->current);
+	free(display->damage);
+	free(display->next);
+	stateDetach(display);
+}
+
+void displaySetSize(display_t* display, int rows, int cols)
+{
+	if (rows == display->dim.x && cols == display->dim.y)
+		return;
+	if (display->screens != NULL
+		&& (rows != display->screens->dim.x || cols != display->screens->dim.y))
+		return;
 
-	display->current = buildStringBlock(rows, cols);
-	#ifdef DISPLAY_COLOR
-	display->current_color = buildColorBlock(rows, cols, display->default_color);
-	#endif
-	#ifdef DISPLAY_BACKGROUND
-	display->current_background = buildColorBlock(rows, cols, display->default_background);
-	#endif
+	freeDisplayContent(display);
+	buildDisplayContent(display, rows, cols);
+	sinksResize(display);
 }
 
 static void checkAndUpdateDisplaySize(display_t* display)
@@ -749,6 +1390,85 @@ static void checkAndUpdateDisplaySize(display_t* display)
     displaySetSize(display, w.ws_row, w.ws_col);
 }
 
+/**
+ * This function sends the scroll noted by padSetView, moving the terminal
+ * rows with a scroll region instead of redrawing them, and moves the known
+ * rows to match. The rows scrolled in are unknown and the
+ * whole region is damaged, so the frame diff fixes anything else that
+ * moved along.
+ * Recordings store cell deltas against display->current, so no scroll is
+ * sent while recording.
+ *
+ * @param display the display
+ * @param known the rows the terminal shows
+ * @param out the frame being built
+ */
+static void scrollRows(display_t *display, cell_t **known, output_t *out)
+{
+	scroll_t scroll = display->scroll;
+	memset(&display->scroll, 0, sizeof(scroll_t));
+	int height = scroll.bottom - scroll.top;
+	int n = scroll.count < 0 ? -scroll.count : scroll.count;
+	if (n == 0 || n >= height
+		|| (display->recorder != NULL && known == display->current)
+		|| !(display->profile->caps & CAP_SCROLL_REGION))
+		return;
+
+	int cols = display->dim.y;
+	size_t row_size = sizeof(cell_t) * cols;
+	outputPrintf(out, "\033[%d;%dr", scroll.top + 1, scroll.bottom);
+	int k;
+	if (scroll.count > 0)
+	{
+		outputPrintf(out, "\033[%d;1H", scroll.bottom);
+		for (k = 0; k < n; k++)
+			outputString(out, "\033D");
+		memmove(known[scroll.top], known[scroll.top + n],
+				row_size * (height - n));
+		memset(known[scroll.bottom - n], 0, row_size * n);
+	}
+	else
+	{
+		outputPrintf(out, "\033[%d;1H", scroll.top + 1);
+		for (k = 0; k < n; k++)
+			outputString(out, "\033M");
+		memmove(known[scroll.top + n], known[scroll.top],
+				row_size * (height - n));
+		memset(known[scroll.top], 0, row_size * n);
+	}
+	outputString(out, "\033[r");
+	damageRect(display, scroll.top, 0, scroll.bottom, cols);
+}
+
+/**
+ * This function opens an update. Until the matching displayCommitUpdate,
+ * window changes only grow a held rectangle per window and displayUpdate
+ * draws nothing, so a frame built by many calls is sent whole.
+ * Updates can be nested; only the outermost commit draws.
+ *
+ * @param display the display
+ */
+void displayBeginUpdate(display_t* display)
+{
+	display->updating++;
+}
+
+/**
+ * This function closes an update opened with displayBeginUpdate, damaging
+ * what each window changed and drawing the frame.
+ *
+ * @param display the display
+ */
+void displayCommitUpdate(display_t* display)
+{
+	if (display->updating == 0 || --display->updating > 0)
+		return;
+	window_t *window;
+	for (window = display->bottom_window; window != NULL; window = window->next)
+		releaseDamage(window);
+	displayUpdate(display);
+}
+
 /**
  * This is the print task for the display.
  * It will only print diffs between the current and next maps.
@@ -758,86 +1478,156 @@ static void checkAndUpdateDisplaySize(display_t* display)
  */
 void displayUpdate(display_t* display)
 {
+	if (display->updating)
+	{
+		return;
+	}
 	checkAndUpdateDisplaySize(display);
 
-	if (display->hidden || !display->dirty)
+	if (display->hidden)
+	{
+		return;
+	}
+	if (!display->dirty)
 	{
+		displayFlushSinks(display);
 		return;
 	}
 	display->dirty = FALSE;
 
-	struct char_struct next;
-	int current_x = -1;
-	int current_y = -1;
-	#ifdef DISPLAY_COLOR
-	int current_color = -1;
-	#endif
-	#ifdef DISPLAY_BACKGROUND
-	int current_background = -1;
-	#endif
-	int i, j;
-	fprintf(display->term, "\033[s");
-	//fprintf(display->term, "\033[?25l");
+	// a page of a screen set keeps its frame in current and only draws
+	// while it is the page shown
+	screen_set_t *screens = display->screens;
+	char shown = screens == NULL || screens->active == display;
+	cell_t **known = screens == NULL ? display->current : screens->known;
+	encoder_t enc;
+	int i;
+	if (shown)
+	{
+		sinksBeginFrame(display);
+		stateBegin(display);
+		encodeBegin(&enc, display, &display->out);
+		scrollRows(display, known, &display->out);
+	}
+	else
+	{
+		memset(&display->scroll, 0, sizeof(scroll_t));
+	}
+	if (display->recorder != NULL)
+		recordBeginFrame(display->recorder);
 	for (i = 0; i < display->dim.x; i++)
 	{
-		for (j = 0; j < display->dim.y; j++)
-		{
-			next = renderPoint(display, display->bottom_window, i, j);
-			if (display->current[i][j] != next.data
-				#ifdef DISPLAY_COLOR
-				|| display->current_color[i][j] != next.color
-				#endif
-				#ifdef DISPLAY_BACKGROUND
-				|| display->current_background[i][j] != next.background
-				#endif
-				)
-			{
-				if (current_x != i || current_y != j)
-				{
-					fprintf(display->term, "\033[%d;%dH", i + 1, j + 1);
-					current_x = i;
-					current_y = j;
-				}
-				
-				#ifdef DISPLAY_COLOR
-				if (current_color != next.color)
-				{
-					fprintf(display->term, "\033[38;5;%dm", next.color);
-					current_color = next.color;
-				}
-				#endif
-				#ifdef DISPLAY_BACKGROUND
-				if (current_background != next.background)
-				{
-					fprintf(display->term, "\033[48;5;%dm", next.background);
-					current_background = next.background;
-				}
-				#endif
-
-				char c = next.data;
-				if (isspace((int)c) || c == '\0')
-				{
-					next.data = ' ';
-				}
-				fprintf(display->term, "%c", next.data);
-				display->current[i][j] = next.data;
-				#ifdef DISPLAY_COLOR
-				display->current_color[i][j] = next.color;
-				#endif
-				#ifdef DISPLAY_BACKGROUND
-				display->current_background[i][j] = next.background;
-				#endif
-				current_y++;
-			}
-		}
+		span_t span = display->damage[i];
+		if (span.start >= span.end)
+			continue;
+		display->damage[i].start = 0;
+		display->damage[i].end = 0;
+		display->kernel->renderRow(display, i, span.start, span.end);
+		if (display->recorder != NULL)
+			recordRow(display->recorder, display->current[i], display->next,
+						i, span.start, span.end);
+		if (screens != NULL)
+			memcpy(display->current[i] + span.start, display->next + span.start,
+					sizeof(cell_t) * (span.end - span.start));
+		if (shown)
+			encodeRow(&enc, known[i], display->next, i, span.start, span.end);
 	}
-	#ifdef DISPLAY_COLOR
-	if (current_color != RESET)
-			fprintf(display->term, "\033[0m");
-	#endif
-	fprintf(display->term, "\033[u");
-	//fprintf(display->term, "\033[?25h");
-	fflush(display->term);
+	if (display->recorder != NULL)
+		recordEndFrame(display->recorder, display);
+	if (!shown)
+		return;
+	encodeEnd(&enc);
+	sinksEndFrame(display, display->out.data, display->out.length);
+	outputFlush(&display->out, display->term);
+	stateCommit(display);
+}
+
+/**
+ * This function picks the compose kernel for the planes a display draws.
+ * Monochrome terminals show no color, so they get the glyph only kernel.
+ *
+ * @param display the display data
+ */
+static void pickKernel(display_t* display)
+{
+	int planes = display->color_depth == COLOR_DEPTH_MONO ? 0 : display->planes;
+	const kernel_t *kernel = kernelSelect(planes);
+	if (kernel == display->kernel)
+		return;
+	display->kernel = kernel;
+	if (display->damage != NULL)
+		damageRect(display, 0, 0, display->dim.x, display->dim.y);
+}
+
+/**
+ * This function sets how many colors the terminal can show.
+ * Colors the terminal cannot show are sent as the closest one it can.
+ * newDisplay guesses the depth from the environment.
+ *
+ * @param display the display data
+ * @param depth the COLOR_DEPTH_* of the terminal
+ */
+void displaySetColorDepth(display_t* display, int depth)
+{
+	if (display->color_depth == depth)
+		return;
+	display->color_depth = depth;
+	pickKernel(display);
+
+	window_t *window;
+	for (window = display->bottom_window; window != NULL; window = window->next)
+	{
+		int i;
+		for (i = 0; i < window->palette.count; i++)
+			paletteStore(window, i, window->palette.entries[i]);
+	}
+	damageRect(display, 0, 0, display->dim.x, display->dim.y);
+}
+
+/**
+ * This function sets which color planes a display draws. Leaving out
+ * FILL_BACKGROUND keeps the terminal's own background; leaving out both
+ * draws glyphs and attributes only. The fastest kernel built for the
+ * planes is used from then on.
+ *
+ * @param display the display data
+ * @param planes FILL_COLOR and FILL_BACKGROUND flags
+ */
+void displaySetPlanes(display_t* display, int planes)
+{
+	display->planes = planes & (FILL_COLOR | FILL_BACKGROUND);
+	pickKernel(display);
+}
+
+/**
+ * This function returns the color planes a display actually draws. It
+ * can be fewer than were asked for with displaySetPlanes when the terminal
+ * is monochrome or the library was built without the kernel for them.
+ * A monochrome terminal gets no colors even when the only kernel built
+ * composes some.
+ *
+ * @param display the display data
+ * @return FILL_COLOR and FILL_BACKGROUND flags
+ */
+int displayDrawnPlanes(display_t* display)
+{
+	if (display->color_depth == COLOR_DEPTH_MONO)
+		return 0;
+	return display->kernel->planes;
+}
+
+/**
+ * This function replaces the output profile picked from the environment,
+ * for example when the terminal type is known better than TERM says.
+ * The color depth is reset to the profile's.
+ *
+ * @param display the display data
+ * @param profile the output profile
+ */
+void displaySetProfile(display_t* display, const term_profile_t *profile)
+{
+	display->profile = profile;
+	displaySetColorDepth(display, profile->color_depth);
 }
 
 void displaySetAutoSize(display_t* display, char autoSet)
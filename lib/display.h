@@ -2,9 +2,7 @@
 #define DISPLAY_H
 
 #include <stdio.h>
-
-#define DISPLAY_BACKGROUND
-#define DISPLAY_COLOR
+#include <stdint.h>
 
 /**
  * display.h is a lite display driver
@@ -39,10 +37,145 @@ enum color_enum
 	BRIGHT_WHITE = 15
 };
 
+enum fill_enum
+{
+	FILL_GLYPH = 1,
+	FILL_COLOR = 2,
+	FILL_BACKGROUND = 4,
+	FILL_ATTR = 8,
+	FILL_ALL = 15
+};
+
 typedef unsigned char color_t;
 typedef unsigned char background_t;
 
+/**
+ * A color value is either one of the 256 indexed colors or a 24 bit
+ * RGB color built with COLOR_RGB.
+ */
+typedef unsigned int color_value_t;
+
+#define COLOR_RGB_FLAG 0x1000000u
+#define COLOR_RGB(r, g, b) (COLOR_RGB_FLAG | ((r) & 0xff) << 16 | ((g) & 0xff) << 8 | ((b) & 0xff))
+#define COLOR_IS_RGB(value) ((value) & COLOR_RGB_FLAG)
+#define COLOR_NONE 0xffffffffu
+
+enum color_depth_enum
+{
+	COLOR_DEPTH_MONO = 1,
+	COLOR_DEPTH_16 = 16,
+	COLOR_DEPTH_256 = 256,
+	COLOR_DEPTH_TRUE = 0x1000000
+};
+
+enum attr_enum
+{
+	ATTR_BOLD = 1,
+	ATTR_DIM = 2,
+	ATTR_ITALIC = 4,
+	ATTR_UNDERLINE = 8,
+	ATTR_BLINK = 16,
+	ATTR_REVERSE = 32,
+	ATTR_ALL = 63
+};
+typedef unsigned char attr_t;
+
+/**
+ * A cell is one character of the terminal as it is sent out, packed into
+ * 8 bytes so a frame diff compares one word per cell.
+ * Indexed colors keep their index in the last color byte; the CELL_*_RGB
+ * attribute bits mark the colors holding 24 bit RGB instead.
+ */
+#define CELL_COLOR_RGB 64
+#define CELL_BACKGROUND_RGB 128
+
+struct cell_struct
+{
+	char data;
+	attr_t attr;
+	unsigned char color[3];
+	unsigned char background[3];
+};
+typedef struct cell_struct cell_t;
+
+/**
+ * How windowPrintLayout places each line in its box.
+ */
+enum layout_enum
+{
+	LAYOUT_LEFT = 0,
+	LAYOUT_CENTER = 1,
+	LAYOUT_RIGHT = 2,
+	LAYOUT_ALIGN = 3,
+	LAYOUT_ELLIPSIS = 4
+};
+
+/**
+ * Transparent window cells show the windows under them, see
+ * windowSetTransparency.
+ */
+enum transparency_enum
+{
+	TRANSPARENT_NONE = 0,
+	TRANSPARENT_UNWRITTEN = 1,
+	TRANSPARENT_MASK = 2
+};
+
+/**
+ * Window cells do not hold colors, they hold slots of the window palette.
+ * The first two slots are the window's default text color and background,
+ * so changing a window's theme is a single palette write.
+ * Every other slot is handed out the first time its color is used, and
+ * given back by a sweep once no cell holds it, see windowPaletteSlot.
+ */
+#define PALETTE_SIZE 256
+#define PALETTE_COLOR 0
+#define PALETTE_BACKGROUND 1
+
+struct palette_struct
+{
+	color_value_t entries[PALETTE_SIZE];
+	color_value_t terminal[PALETTE_SIZE]; // entries degraded to the display
+	unsigned char index_slot[256];
+	int count;
+	unsigned char free_slots[PALETTE_SIZE]; // slots given back by the last sweep
+	int free_count;
+};
+typedef struct palette_struct palette_t;
+
+/**
+ * An output profile describes what a terminal type supports.
+ * The sequences are picked once when the display is created and printed
+ * as they are; an unsupported sequence is an empty string.
+ */
+enum term_cap_enum
+{
+	CAP_EL = 1,             // erase to end of line
+	CAP_ECH = 2,            // erase a number of characters
+	CAP_REP = 4,            // repeat the last character
+	CAP_BCE = 8,            // erases use the current background
+	CAP_SCROLL_REGION = 16, // scroll regions and scrolling
+	CAP_ALT_SCREEN = 32,    // alternate screen buffer
+	CAP_DECCRA = 64,        // copy rectangular area
+	CAP_SYNC = 128          // synchronized update (mode 2026)
+};
+
+struct term_profile_struct
+{
+	const char *name;
+	int caps;
+	int color_depth;
+	const char *clear;
+	const char *cursor_hide;
+	const char *cursor_show;
+	const char *cursor_save;
+	const char *cursor_restore;
+};
+typedef struct term_profile_struct term_profile_t;
+
 struct window_struct;
+struct state_struct;
+struct screen_set_struct;
 
 struct point_struct
 {
@@ -52,17 +185,124 @@ struct point_struct
 typedef struct point_struct point_t;
 typedef struct point_struct dimension_t;
 
+struct span_struct
+{
+	int start;
+	int end;
+};
+typedef struct span_struct span_t;
+
+struct output_struct
+{
+	char *data;
+	size_t length;
+	size_t size;
+};
+typedef struct output_struct output_t;
+
+/**
+ * A sink is an extra viewer of a display, see displayAddSink.
+ * known is only kept up to date while the sink is out of step.
+ */
+struct sink_struct
+{
+	int fd;
+	cell_t *known;
+	output_t pending;
+	char synced;
+	char fresh;
+	char closed;
+	struct sink_struct *next;
+};
+typedef struct sink_struct sink_t;
+
+typedef struct recorder_struct recorder_t;
+
+/**
+ * A replay plays back a recording made with displayStartRecording.
+ * cells holds the screen at time; damage holds the rows changed since the
+ * caller last cleared it. planes holds the color planes the recorded
+ * display drew; the colors of the others are not in the cells.
+ */
+struct replay_struct
+{
+	FILE *file;
+	int rows;
+	int cols;
+	int planes;
+	cell_t *cells;
+	span_t *damage;
+	char resized;
+	uint64_t time;
+	uint64_t start;
+	uint64_t end;
+	unsigned long frames;
+	int keys;
+	long *key_offsets;
+	uint64_t *key_times;
+	long first;
+	char *payload;
+	size_t payload_size;
+};
+typedef struct replay_struct replay_t;
+
+/**
+ * A pad is the canvas behind a window made with newPad. It can be much
+ * larger than the window, which shows the part of it starting at view.
+ * Rows are stored in chunks of PAD_CHUNK_ROWS that are only allocated
+ * once something is written to them.
+ */
+#define PAD_CHUNK_ROWS 256
+
+struct pad_chunk_struct
+{
+	char *contents;
+	attr_t *attrs;
+	color_t *colors;
+	background_t *backgrounds;
+};
+
+struct pad_struct
+{
+	dimension_t dim;
+	point_t view;
+	struct pad_chunk_struct **chunks;
+	int chunk_count;
+};
+typedef struct pad_struct pad_t;
+
+/**
+ * A scroll is a pending move of display rows top to bottom (end exclusive)
+ * up by count rows, or down when count is negative. displayUpdate sends it
+ * as a terminal scroll when that is cheaper than redrawing.
+ */
+struct scroll_struct
+{
+	int top;
+	int bottom;
+	int count;
+};
+typedef struct scroll_struct scroll_t;
+
 struct display_struct
 {
-	char ** current;
-	#ifdef DISPLAY_COLOR
-	color_t ** current_color;
-	color_t default_color;
-	#endif
-	#ifdef DISPLAY_BACKGROUND
-	background_t ** current_background;
-	color_t default_background;
-	#endif
+	cell_t ** current;
+	cell_t * next;
+	output_t out;
+	color_value_t default_color;
+	color_value_t default_background;
+	int color_depth;
+	int planes; // the FILL_COLOR and FILL_BACKGROUND planes to draw
+	const struct kernel_struct *kernel;
+	const term_profile_t *profile;
+	span_t *damage;
+	scroll_t scroll;
+	sink_t *sinks;
+	recorder_t *recorder;
+	struct state_struct *state;
+	size_t state_size;
+	char *state_path;
+	struct screen_set_struct *screens; // the set this display is a page of
 	dimension_t dim;
 	FILE *term;
 	struct window_struct *top_window;
@@ -70,42 +310,175 @@ struct display_struct
 	char hidden;
 	char dirty;
 	char auto_size;
+	int updating; // depth of displayBeginUpdate calls
 };
 typedef struct display_struct display_t;
 
 struct window_struct
 {
 	char ** contents;
-	#ifdef DISPLAY_COLOR
-	color_t color;
+	attr_t attr; // attributes being printed with
+	attr_t ** attrs;
+	palette_t palette;
+	color_t color; // palette slot being printed with
 	color_t ** colors;
-	#endif
-	#ifdef DISPLAY_BACKGROUND
-	background_t background;
+	background_t background; // palette slot being printed with
 	background_t ** backgrounds;
-	#endif
 	point_t pos;
 	dimension_t dim;
 	display_t *display;
 	char boarder;
-	#ifdef DISPLAY_BACKGROUND
 	char setBack;
-	#endif
 	char hidden;
+	char transparency; // TRANSPARENT_* flags
+	unsigned char ** mask; // a bit per cell, set where the window is see through
+	pad_t *pad; // the canvas shown in the content, NULL for plain windows
+	cell_t ** sent; // cells as they are sent, NULL unless made with newCellWindow
+	point_t held_from; // damage held back during an update, raw window
+	point_t held_to;   // coordinates, end exclusive
 	struct window_struct *next;
 	struct window_struct *last;
 };
 typedef struct window_struct window_t;
 
+/**
+ * A screen set shows one of several displays, its pages, on a terminal.
+ * known is what the terminal shows, shared by every page, while each page
+ * keeps its own composed frame, so switching pages only sends the cells
+ * that differ between them.
+ */
+struct screen_set_struct
+{
+	FILE *term;
+	const term_profile_t *profile;
+	int color_depth;
+	cell_t **known;
+	dimension_t dim;
+	display_t **pages;
+	int count;
+	int size;
+	display_t *active;
+	char hidden;
+};
+typedef struct screen_set_struct screen_set_t;
+
+enum input_type_enum
+{
+	INPUT_KEY,
+	INPUT_MOUSE,
+	INPUT_PASTE
+};
+
+/*
+ * Keys that are not characters, past the last Unicode code point.
+ * Characters, including control characters such as KEY_ENTER, come
+ * through as themselves.
+ */
+enum key_enum
+{
+	KEY_TAB = 9,
+	KEY_ENTER = 13,
+	KEY_ESCAPE = 27,
+	KEY_BACKSPACE = 127,
+	KEY_UP = 0x110000,
+	KEY_DOWN,
+	KEY_RIGHT,
+	KEY_LEFT,
+	KEY_HOME,
+	KEY_END,
+	KEY_INSERT,
+	KEY_DELETE,
+	KEY_PAGE_UP,
+	KEY_PAGE_DOWN,
+	KEY_BACKTAB,
+	KEY_F1,
+	KEY_F2,
+	KEY_F3,
+	KEY_F4,
+	KEY_F5,
+	KEY_F6,
+	KEY_F7,
+	KEY_F8,
+	KEY_F9,
+	KEY_F10,
+	KEY_F11,
+	KEY_F12
+};
+
+enum modifier_enum
+{
+	MOD_SHIFT = 1,
+	MOD_ALT = 2,
+	MOD_CTRL = 4
+};
+
+enum mouse_enum
+{
+	MOUSE_LEFT,
+	MOUSE_MIDDLE,
+	MOUSE_RIGHT,
+	MOUSE_NONE,
+	MOUSE_WHEEL_UP,
+	MOUSE_WHEEL_DOWN
+};
+
+enum mouse_action_enum
+{
+	MOUSE_PRESS,
+	MOUSE_RELEASE,
+	MOUSE_MOVE
+};
+
+/**
+ * One decoded piece of terminal input, see inputRead.
+ * For keys, key is a character or a KEY_* value.
+ * For the mouse, key is a MOUSE_* button, pos the display cell and window
+ * the topmost window there, with window_pos inside its content.
+ * For paste, text holds length bytes and stays valid until the next read;
+ * key is 1 while more of the same paste is still to come.
+ */
+struct input_event_struct
+{
+	int type;
+	int key;
+	int modifiers;
+	int action;
+	point_t pos;
+	window_t *window;
+	point_t window_pos;
+	const char *text;
+	size_t length;
+};
+typedef struct input_event_struct input_event_t;
+
+typedef struct input_struct input_t;
+
 display_t *newDisplay(FILE *term, 
 				int rows, 
 				int cols);
+display_t *newDisplayState(FILE *term,
+				int rows,
+				int cols,
+				const char *path);
 window_t *newWindow(display_t *display,
 			    char boarder,	
 				int pos_x, 
 				int pos_y, 
 				int dim_x,
 				int dim_y);
+window_t *newCellWindow(display_t *display,
+				int pos_x,
+				int pos_y,
+				int dim_x,
+				int dim_y);
+window_t *newPad(display_t *display,
+				char boarder,
+				int pos_x,
+				int pos_y,
+				int dim_x,
+				int dim_y,
+				int rows,
+				int cols);
 void windowPrint(window_t *window,
 				char *str,
 				int x,
@@ -121,6 +494,25 @@ void windowPrintBackground(window_t *window,
 				background_t background,
 				int x,
 				int y);
+void windowPrintValue(window_t *window,
+				char *str,
+				color_value_t color,
+				color_value_t background,
+				int x,
+				int y);
+void windowPrintAttr(window_t *window,
+				char *str,
+				attr_t attr,
+				int x,
+				int y);
+int windowPrintLayout(window_t *window,
+				const char *str,
+				int flags,
+				int x,
+				int y,
+				int rows,
+				int cols);
+int layoutLines(const char *str, int width);
 void windowChar(window_t *window,
 				char c,
 				int x,
@@ -132,12 +524,25 @@ void windowCharColor(window_t *window,
 				int y);
 void windowSetColor(window_t *window, color_t color);
 void windowSetBackground(window_t *window, background_t background);
+void windowSetColorValue(window_t *window, color_value_t color);
+void windowSetBackgroundValue(window_t *window, color_value_t background);
+color_t windowPaletteSlot(window_t *window, color_value_t value);
+void windowSetAttr(window_t *window, attr_t attr);
 void windowDrawBackground(window_t *window,
 				background_t background,
 				int start_x,
 				int start_y,
 				int end_x,
 				int end_y);
+void windowFill(window_t *window,
+				int planes,
+				char c,
+				color_t color,
+				background_t background,
+				int x,
+				int y,
+				int rows,
+				int cols);
 void windowSetBoarder(window_t * window,
 				color_t color,
 				background_t background,
@@ -148,13 +553,111 @@ void windowColorBoarder(window_t * window,
 				color_t color,
 				background_t background);
 void windowClear(window_t *window);
+void windowPutCells(window_t *window,
+				const cell_t *cells,
+				int count,
+				int x,
+				int y);
+void padPrint(window_t *window,
+				char *str,
+				int x,
+				int y);
+void padFill(window_t *window,
+				int planes,
+				char c,
+				color_t color,
+				background_t background,
+				int x,
+				int y,
+				int rows,
+				int cols);
+void padSetView(window_t *window, int x, int y);
+void padScroll(window_t *window, int rows);
+void windowSparkline(window_t *window,
+				const float *values,
+				int count,
+				float min,
+				float max,
+				color_value_t color,
+				int x,
+				int y,
+				int cols);
+void windowBars(window_t *window,
+				const float *values,
+				int count,
+				float min,
+				float max,
+				char vertical,
+				color_value_t color,
+				int x,
+				int y,
+				int rows,
+				int cols);
+void windowHeatmap(window_t *window,
+				const float *values,
+				int grid_rows,
+				int grid_cols,
+				float min,
+				float max,
+				const color_value_t *ramp,
+				int ramp_size,
+				int x,
+				int y,
+				int rows,
+				int cols);
 void windowSetHide(window_t *window, char hidden);
+void windowSetTransparency(window_t *window, int transparency);
+void windowSetMask(window_t *window,
+				char transparent,
+				int x,
+				int y,
+				int rows,
+				int cols);
 void displaySetHide(display_t *display, char hidden);
+screen_set_t *newScreenSet(FILE *term, int rows, int cols);
+display_t *screenSetAddPage(screen_set_t *set);
+void screenSetShow(screen_set_t *set, display_t *page);
+void screenSetSize(screen_set_t *set, int rows, int cols);
+void freeScreenSet(screen_set_t *set);
+sink_t *displayAddSink(display_t *display, int fd);
+void displayRemoveSink(display_t *display, sink_t *sink);
+void displayFlushSinks(display_t *display);
+int displayStartRecording(display_t *display, const char *path);
+void displayStopRecording(display_t *display);
+replay_t *openReplay(const char *path);
+int replayNext(replay_t *replay);
+int replaySeek(replay_t *replay, uint64_t time);
+void freeReplay(replay_t *replay);
+input_t *newInput(display_t *display, int fd);
+int inputRead(input_t *input, input_event_t *events, int max);
+int inputParse(input_t *input,
+				const unsigned char *data,
+				size_t length,
+				input_event_t *events,
+				int max,
+				size_t *used);
+int inputFd(input_t *input);
+void freeInput(input_t *input);
+window_t *displayWindowAt(display_t *display, int x, int y);
+void displayRemapColor(display_t *display, color_value_t from, color_value_t to);
 void SetTopWindow(window_t *window);
 void freeWindow(window_t *window);
 void freeDisplay(display_t *display);
 void displayUpdate(display_t* display);
+void displayBeginUpdate(display_t* display);
+void displayCommitUpdate(display_t* display);
 void displaySetAutoSize(display_t* display, char autoSet);
 void displaySetSize(display_t* display, int rows, int cols);
+void displaySetColorDepth(display_t* display, int depth);
+void displaySetPlanes(display_t* display, int planes);
+int displayDrawnPlanes(display_t* display);
+void displaySetProfile(display_t* display, const term_profile_t *profile);
+
+color_value_t colorToRGB(color_value_t value);
+int colorDistance(color_value_t a, color_value_t b);
+color_value_t colorDegrade(color_value_t value, int depth);
+
+const term_profile_t *terminalProfile(const char *term);
+const term_profile_t *terminalDetect(int *color_depth);
 
 #endif // DISPLAY_H
@@ -0,0 +1,100 @@
+#ifndef DISPLAY_INTERNAL_H
+#define DISPLAY_INTERNAL_H
+
+#include <string.h>
+#include "display.h"
+
+#define TRUE 1
+#define FALSE 0
+
+/**
+ * display_internal.h holds what the library files share with each other
+ * but not with programs using the library.
+ */
+
+void outputWrite(output_t *out, const char *data, size_t length);
+void outputPrintf(output_t *out, const char *format, ...);
+void outputFlush(output_t *out, FILE *term);
+void freeOutput(output_t *out);
+
+static inline void outputString(output_t *out, const char *str)
+{
+	outputWrite(out, str, strlen(str));
+}
+
+static inline void outputChar(output_t *out, char c)
+{
+	if (out->length == out->size)
+		outputWrite(out, &c, 1);
+	else
+		out->data[out->length++] = c;
+}
+
+static inline int cellEqual(const cell_t *a, const cell_t *b)
+{
+	return memcmp(a, b, sizeof(cell_t)) == 0;
+}
+
+/**
+ * A kernel composes display rows. Each one is built for a set of planes,
+ * so a display only pays for the planes it draws; see kernel.c.
+ */
+struct kernel_struct
+{
+	const char *name;
+	int planes; // the FILL_COLOR and FILL_BACKGROUND planes drawn
+	void (*renderRow)(display_t *display, int x, int start, int end);
+};
+typedef struct kernel_struct kernel_t;
+
+const kernel_t *kernelSelect(int planes);
+
+/**
+ * The encoder turns the difference between what the terminal shows and the
+ * next frame into escape codes, one row at a time.
+ */
+struct encoder_struct
+{
+	output_t *out;
+	const term_profile_t *profile;
+	int color_depth;
+	int planes;
+	int cols;
+	int x;
+	int y;
+	cell_t style;
+	char styled;
+};
+typedef struct encoder_struct encoder_t;
+
+void encodeBegin(encoder_t *enc, display_t *display, output_t *out);
+void encodeRow(encoder_t *enc, cell_t *known, const cell_t *next, int row, int start, int end);
+void encodeEnd(encoder_t *enc);
+
+cell_t *stateAttach(display_t *display, int rows, int cols, char *valid);
+void stateDetach(display_t *display);
+void stateBegin(display_t *display);
+void stateCommit(display_t *display);
+
+display_t *displayCreate(FILE *term, int rows, int cols, const char *path, char *valid);
+void screenSetRemovePage(screen_set_t *set, display_t *page);
+void screenSetHide(screen_set_t *set);
+
+void windowDamage(window_t *window, int x0, int y0, int x1, int y1);
+color_t windowPaletteSlotKeep(window_t *window, color_value_t value,
+				const unsigned char *keep, int keep_count);
+char padCell(window_t *window, int i, int j, char *c, attr_t *attr,
+				color_t *color, background_t *background);
+void padMarkSlots(pad_t *pad, unsigned char *live);
+void freePad(pad_t *pad);
+
+void sinksBeginFrame(display_t *display);
+void sinksEndFrame(display_t *display, const char *data, size_t length);
+void sinksResize(display_t *display);
+
+void recordBeginFrame(recorder_t *recorder);
+void recordRow(recorder_t *recorder, const cell_t *known, const cell_t *next,
+				int row, int start, int end);
+void recordEndFrame(recorder_t *recorder, display_t *display);
+
+#endif // DISPLAY_INTERNAL_H
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include "display_internal.h"
+
+static int printCellColor(char *out, int ground, const unsigned char *bytes, int rgb, int depth)
+{
+	if (depth == COLOR_DEPTH_MONO)
+		return 0;
+	if (rgb)
+		return sprintf(out, ";%d;2;%d;%d;%d", ground, bytes[0], bytes[1], bytes[2]);
+	if (depth == COLOR_DEPTH_16)
+	{
+		int index = bytes[2] & 0xf;
+		int base = ground == 38 ? 30 : 40;
+		return sprintf(out, ";%d", index < 8 ? base + index : base + 60 + index - 8);
+	}
+	return sprintf(out, ";%d;5;%d", ground, bytes[2]);
+}
+
+/**
+ * This function prints the single SGR escape code that takes the terminal
+ * from the style of one cell to the style of another.
+ * Attributes can only be turned off with a reset, so when one is dropped
+ * (or the current style is unknown) the whole style is sent again.
+ *
+ * @param enc the encoder
+ * @param to the style being switched to
+ */
+static void encodeStyle(encoder_t *enc, const cell_t *to)
+{
+	static const int attr_codes[6] = {1, 2, 3, 4, 5, 7};
+	const cell_t *from = enc->styled ? &enc->style : NULL;
+	char out[64];
+	int n = 0;
+	attr_t add = to->attr & ATTR_ALL;
+	int full = from == NULL || (from->attr & ATTR_ALL & ~to->attr);
+	if (full)
+	{
+		n += sprintf(out + n, ";0");
+	}
+	else
+	{
+		add &= ~from->attr;
+	}
+	int i;
+	for (i = 0; i < 6; i++)
+	{
+		if (add & (1 << i))
+			n += sprintf(out + n, ";%d", attr_codes[i]);
+	}
+	if ((enc->planes & FILL_COLOR) && (full
+		|| (from->attr & CELL_COLOR_RGB) != (to->attr & CELL_COLOR_RGB)
+		|| memcmp(from->color, to->color, 3) != 0))
+		n += printCellColor(out + n, 38, to->color,
+					to->attr & CELL_COLOR_RGB, enc->color_depth);
+	if ((enc->planes & FILL_BACKGROUND) && (full
+		|| (from->attr & CELL_BACKGROUND_RGB) != (to->attr & CELL_BACKGROUND_RGB)
+		|| memcmp(from->background, to->background, 3) != 0))
+		n += printCellColor(out + n, 48, to->background,
+					to->attr & CELL_BACKGROUND_RGB, enc->color_depth);
+	if (n > 0)
+	{
+		outputString(enc->out, "\033[");
+		outputWrite(enc->out, out + 1, n - 1);
+		outputChar(enc->out, 'm');
+	}
+	enc->style = *to;
+	enc->styled = TRUE;
+}
+
+static int digits(int n)
+{
+	int count = 1;
+	while (n >= 10)
+	{
+		n /= 10;
+		count++;
+	}
+	return count;
+}
+
+/**
+ * This function moves the cursor, using a short forward move when the
+ * cursor is already on the right row.
+ *
+ * @param enc the encoder
+ * @param x the row
+ * @param y the column
+ */
+static void encodeMove(encoder_t *enc, int x, int y)
+{
+	if (enc->x == x && enc->y == y)
+		return;
+	if (enc->x == x && enc->y >= 0 && enc->y < y)
+	{
+		int n = y - enc->y;
+		if (n == 1)
+			outputString(enc->out, "\033[C");
+		else
+			outputPrintf(enc->out, "\033[%dC", n);
+	}
+	else
+	{
+		outputPrintf(enc->out, "\033[%d;%dH", x + 1, y + 1);
+	}
+	enc->x = x;
+	enc->y = y;
+}
+
+/**
+ * This function starts encoding a frame for a display.
+ * Terminals with synchronized update hold the frame back until
+ * encodeEnd, so it never shows half drawn.
+ *
+ * @param enc the encoder
+ * @param display the display the frame is for
+ * @param out the output buffer the frame is written to
+ */
+void encodeBegin(encoder_t *enc, display_t *display, output_t *out)
+{
+	enc->out = out;
+	enc->profile = display->profile;
+	enc->color_depth = display->color_depth;
+	enc->planes = displayDrawnPlanes(display);
+	enc->cols = display->dim.y;
+	enc->x = -1;
+	enc->y = -1;
+	enc->styled = FALSE;
+	if (enc->profile->caps & CAP_SYNC)
+		outputString(out, "\033[?2026h");
+	outputString(out, enc->profile->cursor_save);
+}
+
+/**
+ * This function encodes the changes to one row.
+ * Runs of identical cells are sent the cheapest way the terminal allows:
+ * blank runs are erased (EL to the end of the line, ECH elsewhere) and
+ * repeated glyphs are sent once followed by REP, when that is shorter
+ * than sending the changed cells one by one.
+ *
+ * @param enc the encoder
+ * @param known the row the terminal shows, updated to match next
+ * @param next the row being drawn, valid from start to end
+ * @param row the row number
+ * @param start the first column that may have changed
+ * @param end the column after the last column that may have changed
+ */
+void encodeRow(encoder_t *enc,
+				cell_t *known,
+				const cell_t *next,
+				int row,
+				int start,
+				int end)
+{
+	int caps = enc->profile->caps;
+	int j = start;
+	while (j < end)
+	{
+		if (cellEqual(&known[j], &next[j]))
+		{
+			j++;
+			continue;
+		}
+
+		int k = 1;
+		int changed = 1;
+		while (j + k < end && cellEqual(&next[j + k], &next[j]))
+		{
+			changed += !cellEqual(&known[j + k], &next[j]);
+			k++;
+		}
+
+		encodeMove(enc, row, j);
+		if (!enc->styled || memcmp(&enc->style.attr, &next[j].attr, sizeof(cell_t) - 1) != 0)
+			encodeStyle(enc, &next[j]);
+
+		int m;
+		if (k > 1 && next[j].data == ' ' && !(next[j].attr & ATTR_ALL) && (caps & CAP_BCE))
+		{
+			int eol = j + k == end;
+			for (m = end; eol && m < enc->cols; m++)
+				eol = cellEqual(&known[m], &next[j]);
+
+			if (eol && (caps & CAP_EL) && 3 < changed)
+			{
+				outputString(enc->out, "\033[K");
+				for (m = j; m < end; m++)
+					known[m] = next[j];
+				j += k;
+				continue;
+			}
+			if ((caps & CAP_ECH) && 3 + digits(k) + 3 + digits(k) < changed)
+			{
+				outputPrintf(enc->out, "\033[%dX", k);
+				for (m = j; m < j + k; m++)
+					known[m] = next[j];
+				j += k;
+				continue;
+			}
+		}
+		if (k > 2 && (caps & CAP_REP) && 1 + 3 + digits(k - 1) < changed)
+		{
+			outputChar(enc->out, next[j].data);
+			outputPrintf(enc->out, "\033[%db", k - 1);
+			for (m = j; m < j + k; m++)
+				known[m] = next[j];
+			enc->y = j + k;
+			j += k;
+			continue;
+		}
+
+		for (m = j; m < j + k; m++)
+		{
+			if (cellEqual(&known[m], &next[m]))
+				continue;
+			encodeMove(enc, row, m);
+			outputChar(enc->out, next[m].data);
+			known[m] = next[m];
+			enc->y = m + 1;
+		}
+		j += k;
+	}
+	if (enc->y >= enc->cols)
+		enc->y = -1;
+}
+
+/**
+ * This function finishes a frame, leaving the terminal style reset and
+ * the cursor where it was.
+ *
+ * @param enc the encoder
+ */
+void encodeEnd(encoder_t *enc)
+{
+	if (enc->styled)
+		outputString(enc->out, "\033[0m");
+	outputString(enc->out, enc->profile->cursor_restore);
+	if (enc->profile->caps & CAP_SYNC)
+		outputString(enc->out, "\033[?2026l");
+}
@@ -0,0 +1,626 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "display_internal.h"
+
+#define INPUT_BUFFER_SIZE 4096
+#define INPUT_PASTE_SIZE 4096
+#define INPUT_MAX_PARAMS 8
+#define INPUT_MAX_PARAM_VALUE 65535
+
+#define INPUT_MODES_ON "\033[?1000h\033[?1002h\033[?1006h\033[?2004h"
+#define INPUT_MODES_OFF "\033[?2004l\033[?1006l\033[?1002l\033[?1000l"
+#define PASTE_END "\033[201~"
+
+enum input_state_enum
+{
+	S_GROUND,
+	S_ESCAPE,
+	S_CSI,
+	S_SS3,
+	S_CONSOLE, // after "ESC [ [", the Linux console's F1 to F5
+	S_PASTE,
+	STATE_COUNT
+};
+
+enum byte_class_enum
+{
+	C_CTRL,    // C0 controls other than ESC
+	C_ESC,
+	C_DIGIT,
+	C_SEMI,    // ; and :
+	C_PRIV,    // < = > ?
+	C_INTER,   // space to /
+	C_BRACKET, // [
+	C_O,       // O
+	C_FINAL,   // the rest of @ to ~
+	C_DEL,
+	C_HIGH,    // bytes of UTF-8 sequences
+	CLASS_COUNT
+};
+
+enum action_enum
+{
+	A_NONE,
+	A_PRINT,
+	A_CTRL,
+	A_CLEAR,
+	A_PARAM,
+	A_SEP,
+	A_PRIV,
+	A_ALT,
+	A_ESCAPE_KEY,
+	A_CSI,
+	A_SS3,
+	A_CONSOLE
+};
+
+struct transition_struct
+{
+	unsigned char action;
+	unsigned char next;
+};
+
+/**
+ * The decoder state machine. Each byte is classed, then the table gives
+ * the action to run and the state to move to.
+ * Paste contents are not run through the table but scanned for the end
+ * marker.
+ */
+static const struct transition_struct transitions[STATE_COUNT][CLASS_COUNT] = {
+	[S_GROUND] = {
+		[C_CTRL] = {A_CTRL, S_GROUND}, [C_ESC] = {A_NONE, S_ESCAPE},
+		[C_DIGIT] = {A_PRINT, S_GROUND}, [C_SEMI] = {A_PRINT, S_GROUND},
+		[C_PRIV] = {A_PRINT, S_GROUND}, [C_INTER] = {A_PRINT, S_GROUND},
+		[C_BRACKET] = {A_PRINT, S_GROUND}, [C_O] = {A_PRINT, S_GROUND},
+		[C_FINAL] = {A_PRINT, S_GROUND}, [C_DEL] = {A_CTRL, S_GROUND},
+		[C_HIGH] = {A_PRINT, S_GROUND}
+	},
+	[S_ESCAPE] = {
+		[C_CTRL] = {A_ALT, S_GROUND}, [C_ESC] = {A_ESCAPE_KEY, S_ESCAPE},
+		[C_DIGIT] = {A_ALT, S_GROUND}, [C_SEMI] = {A_ALT, S_GROUND},
+		[C_PRIV] = {A_ALT, S_GROUND}, [C_INTER] = {A_ALT, S_GROUND},
+		[C_BRACKET] = {A_CLEAR, S_CSI}, [C_O] = {A_CLEAR, S_SS3},
+		[C_FINAL] = {A_ALT, S_GROUND}, [C_DEL] = {A_ALT, S_GROUND},
+		[C_HIGH] = {A_ALT, S_GROUND}
+	},
+	[S_CSI] = {
+		[C_CTRL] = {A_CTRL, S_CSI}, [C_ESC] = {A_NONE, S_ESCAPE},
+		[C_DIGIT] = {A_PARAM, S_CSI}, [C_SEMI] = {A_SEP, S_CSI},
+		[C_PRIV] = {A_PRIV, S_CSI}, [C_INTER] = {A_NONE, S_CSI},
+		[C_BRACKET] = {A_NONE, S_CONSOLE}, [C_O] = {A_CSI, S_GROUND},
+		[C_FINAL] = {A_CSI, S_GROUND}, [C_DEL] = {A_NONE, S_CSI},
+		[C_HIGH] = {A_NONE, S_GROUND}
+	},
+	[S_SS3] = {
+		[C_CTRL] = {A_NONE, S_GROUND}, [C_ESC] = {A_NONE, S_ESCAPE},
+		[C_DIGIT] = {A_PARAM, S_SS3}, [C_SEMI] = {A_SEP, S_SS3},
+		[C_PRIV] = {A_NONE, S_GROUND}, [C_INTER] = {A_NONE, S_GROUND},
+		[C_BRACKET] = {A_SS3, S_GROUND}, [C_O] = {A_SS3, S_GROUND},
+		[C_FINAL] = {A_SS3, S_GROUND}, [C_DEL] = {A_NONE, S_GROUND},
+		[C_HIGH] = {A_NONE, S_GROUND}
+	},
+	[S_CONSOLE] = {
+		[C_CTRL] = {A_NONE, S_GROUND}, [C_ESC] = {A_NONE, S_ESCAPE},
+		[C_DIGIT] = {A_NONE, S_GROUND}, [C_SEMI] = {A_NONE, S_GROUND},
+		[C_PRIV] = {A_NONE, S_GROUND}, [C_INTER] = {A_NONE, S_GROUND},
+		[C_BRACKET] = {A_NONE, S_GROUND}, [C_O] = {A_NONE, S_GROUND},
+		[C_FINAL] = {A_CONSOLE, S_GROUND}, [C_DEL] = {A_NONE, S_GROUND},
+		[C_HIGH] = {A_NONE, S_GROUND}
+	}
+};
+
+static unsigned char byte_class[256];
+
+static void buildByteClasses(void)
+{
+	int c;
+	for (c = 0; c < 256; c++)
+	{
+		if (c < 0x20) byte_class[c] = C_CTRL;
+		else if (c < 0x30) byte_class[c] = C_INTER;
+		else if (c < 0x3a) byte_class[c] = C_DIGIT;
+		else if (c < 0x3c) byte_class[c] = C_SEMI;
+		else if (c < 0x40) byte_class[c] = C_PRIV;
+		else if (c < 0x7f) byte_class[c] = C_FINAL;
+		else if (c == 0x7f) byte_class[c] = C_DEL;
+		else byte_class[c] = C_HIGH;
+	}
+	byte_class[0x1b] = C_ESC;
+	byte_class['['] = C_BRACKET;
+	byte_class['O'] = C_O;
+}
+
+struct input_struct
+{
+	int fd;
+	display_t *display;
+	struct termios saved;
+	char raw;
+	int flags;
+	unsigned char buffer[INPUT_BUFFER_SIZE];
+	size_t pos;
+	size_t length;
+	int state;
+	int params[INPUT_MAX_PARAMS];
+	int param_count;
+	char priv;
+	int utf8_code;
+	int utf8_need;
+	char paste[INPUT_PASTE_SIZE];
+	size_t paste_length;
+	int paste_match;
+};
+
+/**
+ * This function sets up reading keys and the mouse from a terminal for a
+ * display. The terminal is put in raw mode and the fd made non blocking,
+ * and mouse reports (SGR) and bracketed paste are turned on.
+ * Nothing is allocated after this call.
+ *
+ * @param display the display being shown on the terminal
+ * @param fd the terminal input, usually 0
+ * @return the new input
+ */
+input_t *newInput(display_t *display, int fd)
+{
+	static char classes_built = FALSE;
+	if (!classes_built)
+	{
+		buildByteClasses();
+		classes_built = TRUE;
+	}
+
+	input_t *input = (input_t *)calloc(1, sizeof(input_t));
+	input->fd = fd;
+	input->display = display;
+	input->state = S_GROUND;
+	input->flags = fcntl(fd, F_GETFL);
+	if (input->flags != -1)
+		fcntl(fd, F_SETFL, input->flags | O_NONBLOCK);
+	if (tcgetattr(fd, &input->saved) == 0)
+	{
+		struct termios raw = input->saved;
+		raw.c_iflag &= ~(IXON | ICRNL | BRKINT | INPCK | ISTRIP);
+		raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+		raw.c_cc[VMIN] = 0;
+		raw.c_cc[VTIME] = 0;
+		tcsetattr(fd, TCSANOW, &raw);
+		input->raw = TRUE;
+		fputs(INPUT_MODES_ON, display->term);
+		fflush(display->term);
+	}
+	return input;
+}
+
+/**
+ * This function puts the terminal back the way newInput found it.
+ *
+ * @param input the input
+ */
+void freeInput(input_t *input)
+{
+	if (input->raw)
+	{
+		fputs(INPUT_MODES_OFF, input->display->term);
+		fflush(input->display->term);
+		tcsetattr(input->fd, TCSANOW, &input->saved);
+	}
+	if (input->flags != -1)
+		fcntl(input->fd, F_SETFL, input->flags);
+	free(input);
+}
+
+/**
+ * This function tells whether a window shows the windows under it at one
+ * of its cells, the same way the render kernels decide it.
+ *
+ * @param window the window
+ * @param i the row in the window
+ * @param j the column in the window
+ * @return TRUE if the cell is see through
+ */
+static char windowTransparentAt(window_t *window, int i, int j)
+{
+	if ((window->transparency & TRANSPARENT_MASK)
+		&& (window->mask[i][j >> 3] & (1 << (j & 7))))
+		return TRUE;
+	if (!(window->transparency & TRANSPARENT_UNWRITTEN))
+		return FALSE;
+	char c = window->contents[i][j];
+	if (window->pad != NULL)
+	{
+		attr_t attr;
+		color_t color;
+		background_t background;
+		padCell(window, i, j, &c, &attr, &color, &background);
+	}
+	return c == '\0';
+}
+
+/**
+ * This function finds the topmost shown window covering a display cell.
+ * Windows that are see through at the cell are passed over, as they are
+ * when drawing.
+ *
+ * @param display the display
+ * @param x the row
+ * @param y the column
+ * @return the window, NULL if there is none
+ */
+window_t *displayWindowAt(display_t *display, int x, int y)
+{
+	window_t *window;
+	for (window = display->top_window; window != NULL; window = window->last)
+	{
+		if (!window->hidden
+			&& x >= window->pos.x && x < window->pos.x + window->dim.x
+			&& y >= window->pos.y && y < window->pos.y + window->dim.y
+			&& !windowTransparentAt(window, x - window->pos.x, y - window->pos.y))
+			return window;
+	}
+	return NULL;
+}
+
+static input_event_t *keyEvent(input_event_t *event, int key, int modifiers)
+{
+	event->type = INPUT_KEY;
+	event->key = key;
+	event->modifiers = modifiers;
+	return event;
+}
+
+static int csiModifiers(input_t *input, int index)
+{
+	if (input->param_count <= index || input->params[index] < 2)
+		return 0;
+	return input->params[index] - 1;
+}
+
+static int tildeKey(int code)
+{
+	switch (code)
+	{
+		case 1: case 7: return KEY_HOME;
+		case 2: return KEY_INSERT;
+		case 3: return KEY_DELETE;
+		case 4: case 8: return KEY_END;
+		case 5: return KEY_PAGE_UP;
+		case 6: return KEY_PAGE_DOWN;
+		case 11: case 12: case 13: case 14: case 15: return KEY_F1 + code - 11;
+		case 17: case 18: case 19: case 20: case 21: return KEY_F6 + code - 17;
+		case 23: case 24: return KEY_F11 + code - 23;
+	}
+	return 0;
+}
+
+static int finalKey(unsigned char final)
+{
+	switch (final)
+	{
+		case 'A': return KEY_UP;
+		case 'B': return KEY_DOWN;
+		case 'C': return KEY_RIGHT;
+		case 'D': return KEY_LEFT;
+		case 'H': return KEY_HOME;
+		case 'F': return KEY_END;
+		case 'P': return KEY_F1;
+		case 'Q': return KEY_F2;
+		case 'R': return KEY_F3;
+		case 'S': return KEY_F4;
+		case 'M': return KEY_ENTER;
+	}
+	return 0;
+}
+
+static int mouseEvent(input_t *input, input_event_t *event, unsigned char final)
+{
+	if (input->param_count < 3)
+		return 0;
+	int b = input->params[0];
+	event->type = INPUT_MOUSE;
+	event->modifiers = ((b & 4) ? MOD_SHIFT : 0) | ((b & 8) ? MOD_ALT : 0)
+				| ((b & 16) ? MOD_CTRL : 0);
+	event->key = (b & 64) ? MOUSE_WHEEL_UP + (b & 1) : (b & 3) == 3 ? MOUSE_NONE : MOUSE_LEFT + (b & 3);
+	event->action = final == 'm' ? MOUSE_RELEASE : (b & 32) ? MOUSE_MOVE : MOUSE_PRESS;
+	event->pos.x = input->params[2] - 1;
+	event->pos.y = input->params[1] - 1;
+	event->window = displayWindowAt(input->display, event->pos.x, event->pos.y);
+	event->window_pos = event->pos;
+	if (event->window != NULL)
+	{
+		int d = event->window->boarder ? 1 : 0;
+		event->window_pos.x -= event->window->pos.x + d;
+		event->window_pos.y -= event->window->pos.y + d;
+	}
+	return 1;
+}
+
+/**
+ * This function turns a finished CSI sequence into an event.
+ *
+ * @return 1 if an event was made, 0 if the sequence means nothing here
+ */
+static int csiEvent(input_t *input, input_event_t *event, unsigned char final)
+{
+	if (input->priv == '<' && (final == 'M' || final == 'm'))
+		return mouseEvent(input, event, final);
+	if (input->priv)
+		return 0;
+	if (final == '~')
+	{
+		int code = input->param_count > 0 ? input->params[0] : 0;
+		if (code == 200)
+		{
+			input->state = S_PASTE;
+			input->paste_length = 0;
+			input->paste_match = 0;
+			return 0;
+		}
+		int key = tildeKey(code);
+		return key ? keyEvent(event, key, csiModifiers(input, 1)) != NULL : 0;
+	}
+	if (final == 'Z')
+		return keyEvent(event, KEY_BACKTAB, MOD_SHIFT) != NULL;
+	int key = finalKey(final);
+	return key ? keyEvent(event, key, csiModifiers(input, 1)) != NULL : 0;
+}
+
+static int pasteEvent(input_t *input, input_event_t *event, char done)
+{
+	event->type = INPUT_PASTE;
+	event->key = done ? 0 : 1;
+	event->modifiers = 0;
+	event->text = input->paste;
+	event->length = input->paste_length;
+	return 1;
+}
+
+/**
+ * This function runs bytes of bracketed paste, stopping after the end
+ * marker or when the paste buffer fills.
+ *
+ * @return the number of bytes used
+ */
+static size_t pasteBytes(input_t *input, const unsigned char *data, size_t length, int *made, input_event_t *event)
+{
+	static const char end[] = PASTE_END;
+	size_t i = 0;
+	while (i < length)
+	{
+		if (input->paste_match == 0)
+		{
+			const unsigned char *esc = memchr(data + i, 0x1b, length - i);
+			size_t run = (esc != NULL ? (size_t)(esc - data) : length) - i;
+			size_t room = INPUT_PASTE_SIZE - input->paste_length;
+			if (run > room)
+				run = room;
+			memcpy(input->paste + input->paste_length, data + i, run);
+			input->paste_length += run;
+			i += run;
+			if (input->paste_length == INPUT_PASTE_SIZE)
+			{
+				*made = pasteEvent(input, event, FALSE);
+				input->paste_length = 0;
+				return i;
+			}
+			if (i == length)
+				break;
+		}
+		if (data[i] == (unsigned char)end[input->paste_match])
+		{
+			input->paste_match++;
+			i++;
+			if (end[input->paste_match] == '\0')
+			{
+				input->state = S_GROUND;
+				input->paste_match = 0;
+				*made = pasteEvent(input, event, TRUE);
+				return i;
+			}
+			continue;
+		}
+		// not the end marker after all, keep what matched as text
+		size_t kept = input->paste_match;
+		if (input->paste_length + kept > INPUT_PASTE_SIZE)
+		{
+			*made = pasteEvent(input, event, FALSE);
+			input->paste_length = 0;
+		}
+		memcpy(input->paste + input->paste_length, end, kept);
+		input->paste_length += kept;
+		input->paste_match = 0;
+		if (*made)
+			return i;
+	}
+	return i;
+}
+
+/**
+ * This function decodes terminal input bytes into events.
+ * It keeps its place between calls, so sequences may be split across
+ * them. Decoding stops when max events are made or after a paste event,
+ * whose text stays valid until the next call.
+ *
+ * @param input the input
+ * @param data the bytes
+ * @param length the number of bytes
+ * @param events filled with the events
+ * @param max the room in events
+ * @param used set to the number of bytes used
+ * @return the number of events made
+ */
+int inputParse(input_t *input,
+				const unsigned char *data,
+				size_t length,
+				input_event_t *events,
+				int max,
+				size_t *used)
+{
+	int count = 0;
+	size_t i = 0;
+	while (i < length && count < max)
+	{
+		input_event_t *event = &events[count];
+		if (input->state == S_PASTE)
+		{
+			int made = 0;
+			i += pasteBytes(input, data + i, length - i, &made, event);
+			if (made)
+			{
+				count++;
+				break;
+			}
+			continue;
+		}
+
+		unsigned char c = data[i++];
+		const struct transition_struct *t = &transitions[input->state][byte_class[c]];
+		input->state = t->next;
+		switch (t->action)
+		{
+			case A_PRINT:
+				if (c < 0x80)
+				{
+					input->utf8_need = 0;
+					keyEvent(event, c, 0);
+					count++;
+				}
+				else if (c >= 0xc0)
+				{
+					input->utf8_need = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : 1;
+					input->utf8_code = c & (0x3f >> input->utf8_need);
+				}
+				else if (input->utf8_need > 0)
+				{
+					input->utf8_code = (input->utf8_code << 6) | (c & 0x3f);
+					if (--input->utf8_need == 0)
+					{
+						keyEvent(event, input->utf8_code, 0);
+						count++;
+					}
+				}
+				break;
+			case A_CTRL:
+				keyEvent(event, c, 0);
+				count++;
+				break;
+			case A_ALT:
+				keyEvent(event, c, MOD_ALT);
+				count++;
+				break;
+			case A_ESCAPE_KEY:
+				keyEvent(event, KEY_ESCAPE, 0);
+				count++;
+				break;
+			case A_CLEAR:
+				input->param_count = 0;
+				input->params[0] = 0;
+				input->priv = 0;
+				break;
+			case A_PARAM:
+				if (input->param_count == 0)
+					input->param_count = 1;
+				if (input->param_count <= INPUT_MAX_PARAMS)
+				{
+					// a value stops growing past any real one, so a run of
+					// digits cannot overflow it
+					int *param = &input->params[input->param_count - 1];
+					if (*param <= INPUT_MAX_PARAM_VALUE)
+						*param = *param * 10 + (c - '0');
+				}
+				break;
+			case A_SEP:
+				if (input->param_count == 0)
+					input->param_count = 1;
+				if (input->param_count < INPUT_MAX_PARAMS)
+					input->params[input->param_count] = 0;
+				if (input->param_count <= INPUT_MAX_PARAMS)
+					input->param_count++;
+				break;
+			case A_PRIV:
+				input->priv = c;
+				break;
+			case A_CSI:
+				if (input->param_count > INPUT_MAX_PARAMS)
+					input->param_count = INPUT_MAX_PARAMS;
+				count += csiEvent(input, event, c);
+				break;
+			case A_SS3:
+				if (finalKey(c))
+				{
+					keyEvent(event, finalKey(c), csiModifiers(input, 1));
+					count++;
+				}
+				break;
+			case A_CONSOLE:
+				if (c >= 'A' && c <= 'E')
+				{
+					keyEvent(event, KEY_F1 + c - 'A', 0);
+					count++;
+				}
+				break;
+		}
+	}
+	*used = i;
+	return count;
+}
+
+/**
+ * This function reads everything the terminal has sent so far in one read
+ * and decodes it into events. It never blocks.
+ * A lone ESC is only taken as the Escape key once a call finds nothing
+ * more to read after it.
+ *
+ * @param input the input
+ * @param events filled with the events
+ * @param max the room in events
+ * @return the number of events made
+ */
+int inputRead(input_t *input, input_event_t *events, int max)
+{
+	int count = 0;
+	char got = FALSE;
+	for (;;)
+	{
+		if (input->pos == input->length)
+		{
+			ssize_t n = read(input->fd, input->buffer, INPUT_BUFFER_SIZE);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break;
+			input->pos = 0;
+			input->length = n;
+			got = TRUE;
+		}
+		size_t used;
+		int made = inputParse(input, input->buffer + input->pos,
+					input->length - input->pos, events + count, max - count, &used);
+		input->pos += used;
+		count += made;
+		if (count == max || (made > 0 && events[count - 1].type == INPUT_PASTE))
+			return count;
+	}
+	if (!got && input->state == S_ESCAPE && count < max)
+	{
+		input->state = S_GROUND;
+		keyEvent(&events[count++], KEY_ESCAPE, 0);
+	}
+	return count;
+}
+
+/**
+ * This function gives the fd to wait on, for example with poll, before
+ * calling inputRead.
+ *
+ * @param input the input
+ * @return the fd
+ */
+int inputFd(input_t *input)
+{
+	return input->fd;
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <ctype.h>
+#include "display_internal.h"
+
+/*
+ * The CMake options DISPLAY_KERNEL_GLYPH, DISPLAY_KERNEL_COLOR and
+ * DISPLAY_KERNEL_FULL choose which kernels are built. A build without any
+ * of them gets the full one.
+ */
+#if !defined(DISPLAY_KERNEL_GLYPH) && !defined(DISPLAY_KERNEL_COLOR) && !defined(DISPLAY_KERNEL_FULL)
+#define DISPLAY_KERNEL_FULL
+#endif
+
+/**
+ * This function packs a terminal color value into the 3 color bytes of a
+ * cell and returns the CELL_*_RGB bit it needs.
+ * RGB values fill all 3 bytes while indexes land in the last one, so no
+ * branch is needed.
+ */
+static inline attr_t packColor(unsigned char *bytes, color_value_t value, attr_t rgb_flag)
+{
+	bytes[0] = (value >> 16) & 0xff;
+	bytes[1] = (value >> 8) & 0xff;
+	bytes[2] = value & 0xff;
+	return COLOR_IS_RGB(value) ? rgb_flag : 0;
+}
+
+/**
+ * This function is the reverse of packColor.
+ */
+static inline color_value_t unpackColor(const unsigned char *bytes, attr_t rgb)
+{
+	if (rgb)
+		return COLOR_RGB(bytes[0], bytes[1], bytes[2]);
+	return bytes[2];
+}
+
+#ifdef DISPLAY_KERNEL_GLYPH
+#define KERNEL(name) name##Glyph
+#define KERNEL_COLOR 0
+#define KERNEL_BACKGROUND 0
+#include "kernel.h"
+#undef KERNEL
+#undef KERNEL_COLOR
+#undef KERNEL_BACKGROUND
+#endif
+
+#ifdef DISPLAY_KERNEL_COLOR
+#define KERNEL(name) name##Color
+#define KERNEL_COLOR 1
+#define KERNEL_BACKGROUND 0
+#include "kernel.h"
+#undef KERNEL
+#undef KERNEL_COLOR
+#undef KERNEL_BACKGROUND
+#endif
+
+#ifdef DISPLAY_KERNEL_FULL
+#define KERNEL(name) name##Full
+#define KERNEL_COLOR 1
+#define KERNEL_BACKGROUND 1
+#include "kernel.h"
+#undef KERNEL
+#undef KERNEL_COLOR
+#undef KERNEL_BACKGROUND
+#endif
+
+/*
+ * The kernels built, fewest planes first.
+ */
+static const kernel_t kernels[] = {
+	#ifdef DISPLAY_KERNEL_GLYPH
+	{"glyph", 0, renderRowGlyph},
+	#endif
+	#ifdef DISPLAY_KERNEL_COLOR
+	{"color", FILL_COLOR, renderRowColor},
+	#endif
+	#ifdef DISPLAY_KERNEL_FULL
+	{"full", FILL_COLOR | FILL_BACKGROUND, renderRowFull},
+	#endif
+};
+
+/**
+ * This function picks the kernel for a display: the built kernel with the
+ * fewest planes that still draws every plane asked for, or the one with
+ * the most planes when none does.
+ *
+ * @param planes the FILL_COLOR and FILL_BACKGROUND planes to draw
+ * @return the kernel
+ */
+const kernel_t *kernelSelect(int planes)
+{
+	int count = sizeof(kernels) / sizeof(kernels[0]);
+	int i;
+	for (i = 0; i < count; i++)
+	{
+		if ((kernels[i].planes & planes) == planes)
+			return &kernels[i];
+	}
+	return &kernels[count - 1];
+}
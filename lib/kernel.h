@@ -0,0 +1,152 @@
+/**
+ * kernel.h is the compose kernel. kernel.c includes it once per variant,
+ * after setting KERNEL(name) to name the variant's functions and
+ * KERNEL_COLOR and KERNEL_BACKGROUND to 1 or 0 for the planes it draws.
+ * The plane tests are constants, so each variant is compiled without the
+ * work for the planes it leaves out; their cell bytes stay zero.
+ */
+
+/**
+ * This function builds the terminal cell for a glyph, attributes and
+ * palette slots of a window.
+ */
+static inline cell_t KERNEL(packCell)(window_t *window,
+				char c,
+				attr_t attr,
+				color_t color_slot,
+				background_t background_slot)
+{
+	cell_t cell;
+	memset(&cell, 0, sizeof(cell_t));
+	cell.data = isspace((int)c) || c == '\0' ? ' ' : c;
+	cell.attr = attr;
+	if (KERNEL_COLOR)
+		cell.attr |= packColor(cell.color, window->palette.terminal[color_slot],
+					CELL_COLOR_RGB);
+	if (KERNEL_BACKGROUND)
+		cell.attr |= packColor(cell.background, window->palette.terminal[background_slot],
+					CELL_BACKGROUND_RGB);
+	return cell;
+}
+
+/**
+ * This function builds the terminal cell for a cell of a window made with
+ * newCellWindow, keeping only the planes the kernel draws and degrading
+ * the colors to the display.
+ */
+static inline cell_t KERNEL(sentCell)(window_t *window, char c, const cell_t *sent)
+{
+	int depth = window->display->color_depth;
+	cell_t cell;
+	memset(&cell, 0, sizeof(cell_t));
+	cell.data = isspace((int)c) || c == '\0' ? ' ' : c;
+	cell.attr = sent->attr & ATTR_ALL;
+	if (KERNEL_COLOR)
+		cell.attr |= packColor(cell.color, colorDegrade(unpackColor(sent->color,
+					sent->attr & CELL_COLOR_RGB), depth), CELL_COLOR_RGB);
+	if (KERNEL_BACKGROUND)
+		cell.attr |= packColor(cell.background, colorDegrade(unpackColor(sent->background,
+					sent->attr & CELL_BACKGROUND_RGB), depth), CELL_BACKGROUND_RGB);
+	return cell;
+}
+
+/**
+ * This function builds the terminal cell for one cell of a window.
+ *
+ * @param window the window
+ * @param i the row in the window
+ * @param j the column in the window
+ * @param transparent set to whether the window is see through there,
+ *                    NULL when the window is opaque
+ * @return the cell as it is sent out
+ */
+static inline cell_t KERNEL(windowCell)(window_t *window, int i, int j, char *transparent)
+{
+	char c = window->contents[i][j];
+	attr_t attr = window->attrs[i][j];
+	color_t color = KERNEL_COLOR ? window->colors[i][j] : PALETTE_COLOR;
+	background_t background = KERNEL_BACKGROUND ? window->backgrounds[i][j] : PALETTE_BACKGROUND;
+	if (window->pad != NULL)
+		padCell(window, i, j, &c, &attr, &color, &background);
+	if (transparent != NULL)
+		*transparent = ((window->transparency & TRANSPARENT_MASK)
+				&& (window->mask[i][j >> 3] & (1 << (j & 7))))
+			|| ((window->transparency & TRANSPARENT_UNWRITTEN) && c == '\0');
+	if (window->sent != NULL)
+		return KERNEL(sentCell)(window, c, &window->sent[i][j]);
+	return KERNEL(packCell)(window, c, attr, color, background);
+}
+
+/**
+ * This function composes columns start to end of a display row into
+ * display->next.
+ * Windows are walked from the top down and each cell is taken from the
+ * first window that covers it and is not transparent there, so a column
+ * is done as soon as it is found. Opaque windows take every open column
+ * they cover without checking for transparency.
+ * A rendered cell never holds '\0', which marks the open columns.
+ *
+ * @param display the display
+ * @param x the row
+ * @param start the first column
+ * @param end the column after the last column
+ */
+static void KERNEL(renderRow)(display_t *display, int x, int start, int end)
+{
+	cell_t *row = display->next;
+	int open = end - start;
+	int j;
+	for (j = start; j < end; j++)
+		row[j].data = '\0';
+
+	window_t *window;
+	for (window = display->top_window; window != NULL && open > 0; window = window->last)
+	{
+		int i = x - window->pos.x;
+		if (window->hidden || i < 0 || i >= window->dim.x)
+			continue;
+		int j0 = window->pos.y > start ? window->pos.y : start;
+		int j1 = window->pos.y + window->dim.y < end ? window->pos.y + window->dim.y : end;
+		int y = window->pos.y;
+		if (!window->transparency && window->pad == NULL)
+		{
+			for (j = j0; j < j1; j++)
+			{
+				if (row[j].data != '\0')
+					continue;
+				row[j] = KERNEL(windowCell)(window, i, j - y, NULL);
+				open--;
+			}
+			continue;
+		}
+		for (j = j0; j < j1; j++)
+		{
+			if (row[j].data != '\0')
+				continue;
+			char transparent;
+			cell_t cell = KERNEL(windowCell)(window, i, j - y, &transparent);
+			if (transparent)
+				continue;
+			row[j] = cell;
+			open--;
+		}
+	}
+	if (open == 0)
+		return;
+
+	cell_t blank;
+	memset(&blank, 0, sizeof(cell_t));
+	blank.data = ' ';
+	if (KERNEL_COLOR)
+		blank.attr |= packColor(blank.color,
+					colorDegrade(display->default_color, display->color_depth), CELL_COLOR_RGB);
+	if (KERNEL_BACKGROUND)
+		blank.attr |= packColor(blank.background,
+					colorDegrade(display->default_background, display->color_depth),
+					CELL_BACKGROUND_RGB);
+	for (j = start; j < end; j++)
+	{
+		if (row[j].data == '\0')
+			row[j] = blank;
+	}
+}
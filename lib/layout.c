@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "display_internal.h"
+
+#define LAYOUT_CACHE_SIZE 64
+
+/**
+ * A layout is where a text breaks into lines at a width. Layouts are kept
+ * in a small direct mapped cache keyed by the text's hash and the width,
+ * so text that is drawn every frame is only laid out again when it or the
+ * width changes. Each entry keeps a copy of its text, so two texts with
+ * the same hash never share a layout.
+ */
+struct layout_struct
+{
+	uint64_t hash;
+	size_t length;
+	char *text;
+	size_t text_size;
+	int width;
+	int count;
+	int size;
+	span_t *lines; // start and end offsets into the text
+};
+
+static struct layout_struct cache[LAYOUT_CACHE_SIZE];
+
+static uint64_t textHash(const char *str, size_t *length)
+{
+	uint64_t hash = 14695981039346656037ull;
+	const unsigned char *c = (const unsigned char *)str;
+	while (*c != '\0')
+	{
+		hash ^= *c++;
+		hash *= 1099511628211ull;
+	}
+	*length = (size_t)((const char *)c - str);
+	return hash;
+}
+
+static void addLine(struct layout_struct *layout, int start, int end)
+{
+	if (layout->count == layout->size)
+	{
+		layout->size = layout->size ? layout->size * 2 : 16;
+		layout->lines = (span_t *)realloc(layout->lines, sizeof(span_t) * layout->size);
+	}
+	layout->lines[layout->count].start = start;
+	layout->lines[layout->count].end = end;
+	layout->count++;
+}
+
+static char isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * This function breaks a text into lines no wider than width.
+ * Lines break after the last space that fits, and words longer than a
+ * line are split. A new line in the text always breaks; the spaces a line
+ * breaks at are dropped.
+ *
+ * @param layout the layout being filled
+ * @param str the text
+ * @param width the width of a line
+ */
+static void layoutText(struct layout_struct *layout, const char *str, int width)
+{
+	int length = (int)layout->length;
+	int start = 0;
+	layout->count = 0;
+	while (start <= length)
+	{
+		int end = start;
+		int space = -1;
+		while (end < length && str[end] != '\n' && end - start < width)
+		{
+			if (isBlank(str[end]))
+				space = end;
+			end++;
+		}
+		if (end == length || str[end] == '\n')
+		{
+			addLine(layout, start, end);
+			start = end + 1;
+			continue;
+		}
+		// the line is full, break at its last space if the next char is not one
+		if (!isBlank(str[end]) && space > start)
+			end = space;
+		int next = end;
+		while (end > start && isBlank(str[end - 1]))
+			end--;
+		while (next < length && isBlank(str[next]))
+			next++;
+		if (next < length && str[next] == '\n')
+			next++;
+		addLine(layout, start, end);
+		start = next;
+		if (start == length)
+			break;
+	}
+}
+
+/**
+ * This function finds the layout of a text at a width, laying it out only
+ * when the cache does not hold it.
+ */
+static struct layout_struct *layoutFind(const char *str, int width)
+{
+	size_t length;
+	uint64_t hash = textHash(str, &length);
+	struct layout_struct *layout = &cache[(hash ^ (uint64_t)width * 0x9e3779b97f4a7c15ull)
+						% LAYOUT_CACHE_SIZE];
+	if (layout->lines != NULL && layout->hash == hash
+		&& layout->length == length && layout->width == width
+		&& memcmp(layout->text, str, length) == 0)
+		return layout;
+	if (layout->text_size < length + 1)
+	{
+		layout->text_size = length + 1;
+		layout->text = (char *)realloc(layout->text, layout->text_size);
+	}
+	memcpy(layout->text, str, length + 1);
+	layout->hash = hash;
+	layout->length = length;
+	layout->width = width;
+	layoutText(layout, str, width);
+	return layout;
+}
+
+/**
+ * This function counts the lines a text takes when wrapped to a width.
+ *
+ * @param str the text
+ * @param width the width of a line
+ * @return the number of lines
+ */
+int layoutLines(const char *str, int width)
+{
+	if (width < 1)
+		return 0;
+	return layoutFind(str, width)->count;
+}
+
+/**
+ * This function writes one row of a text box: the line's text placed by
+ * the alignment, and blanks around it, in the window's pen.
+ */
+static void writeRow(window_t *window,
+				const char *text,
+				int length,
+				int x,
+				int y,
+				int cols,
+				int align)
+{
+	int offset = 0;
+	if (align == LAYOUT_RIGHT)
+		offset = cols - length;
+	else if (align == LAYOUT_CENTER)
+		offset = (cols - length) / 2;
+	char *contents = window->contents[x] + y;
+	memset(contents, ' ', cols);
+	memcpy(contents + offset, text, length);
+	int j;
+	for (j = offset; j < offset + length; j++)
+	{
+		if (contents[j] == '\t' || contents[j] == '\r')
+			contents[j] = ' ';
+	}
+	memset(window->attrs[x] + y, window->attr, cols);
+	memset(window->colors[x] + y, window->color, cols);
+	if (window->setBack)
+		memset(window->backgrounds[x] + y, window->background, cols);
+}
+
+/**
+ * This function prints a text into a box of a window's content, wrapping
+ * it at word boundaries. The whole box is written: lines are placed by
+ * the alignment and the rest is blank. When the text needs more lines
+ * than the box has, the last one ends in "..." if LAYOUT_ELLIPSIS is set.
+ * Line breaks are cached, so printing the same text at the same width
+ * again only copies the lines.
+ *
+ * @param window the window being printed to
+ * @param str the text being printed
+ * @param flags LAYOUT_LEFT, LAYOUT_CENTER or LAYOUT_RIGHT, and LAYOUT_ELLIPSIS
+ * @param x the first row of the box
+ * @param y the first column of the box
+ * @param rows the number of rows of the box
+ * @param cols the number of columns of the box
+ * @return the number of lines the text needs at this width
+ */
+int windowPrintLayout(window_t *window,
+				const char *str,
+				int flags,
+				int x,
+				int y,
+				int rows,
+				int cols)
+{
+	int d = window->boarder ? 1: 0;
+	x += d;
+	y += d;
+	if (x < d)
+	{
+		rows += x - d;
+		x = d;
+	}
+	if (y < d)
+	{
+		cols += y - d;
+		y = d;
+	}
+	if (x + rows > window->dim.x - d) rows = window->dim.x - d - x;
+	if (y + cols > window->dim.y - d) cols = window->dim.y - d - y;
+	if (rows <= 0 || cols <= 0)
+		return 0;
+
+	struct layout_struct *layout = layoutFind(str, cols);
+	int align = flags & LAYOUT_ALIGN;
+	int k;
+	for (k = 0; k < rows; k++)
+	{
+		if (k >= layout->count)
+		{
+			writeRow(window, str, 0, x + k, y, cols, LAYOUT_LEFT);
+			continue;
+		}
+		span_t line = layout->lines[k];
+		int length = line.end - line.start;
+		if (k == rows - 1 && layout->count > rows && (flags & LAYOUT_ELLIPSIS))
+		{
+			int dots = cols < 3 ? cols : 3;
+			if (length > cols - dots)
+				length = cols - dots;
+			writeRow(window, str + line.start, length, x + k, y, cols, LAYOUT_LEFT);
+			int offset = align == LAYOUT_RIGHT ? cols - length - dots
+					: align == LAYOUT_CENTER ? (cols - length - dots) / 2 : 0;
+			if (offset > 0)
+			{
+				memmove(window->contents[x + k] + y + offset, window->contents[x + k] + y, length);
+				memset(window->contents[x + k] + y, ' ', offset);
+			}
+			memset(window->contents[x + k] + y + offset + length, '.', dots);
+			continue;
+		}
+		writeRow(window, str + line.start, length, x + k, y, cols, align);
+	}
+	windowDamage(window, x, y, x + rows, y + cols);
+	return layout->count;
+}
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "display_internal.h"
+
+#define OUTPUT_MIN_SIZE 4096
+
+/**
+ * This function appends bytes to an output buffer, growing it as needed.
+ *
+ * @param out the output buffer
+ * @param data the bytes being added
+ * @param length the number of bytes
+ */
+void outputWrite(output_t *out, const char *data, size_t length)
+{
+	if (out->length + length > out->size)
+	{
+		size_t size = out->size ? out->size : OUTPUT_MIN_SIZE;
+		while (size < out->length + length)
+			size *= 2;
+		out->data = (char *)realloc(out->data, size);
+		out->size = size;
+	}
+	memcpy(out->data + out->length, data, length);
+	out->length += length;
+}
+
+/**
+ * This function appends formatted text to an output buffer.
+ *
+ * @param out the output buffer
+ * @param format the printf format
+ */
+void outputPrintf(output_t *out, const char *format, ...)
+{
+	char text[64];
+	va_list args;
+	va_start(args, format);
+	int n = vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+	if (n > 0)
+		outputWrite(out, text, n < (int)sizeof(text) ? (size_t)n : sizeof(text) - 1);
+}
+
+/**
+ * This function sends everything in an output buffer to a terminal in one
+ * write and empties the buffer.
+ *
+ * @param out the output buffer
+ * @param term the terminal
+ */
+void outputFlush(output_t *out, FILE *term)
+{
+	if (out->length > 0)
+		fwrite(out->data, 1, out->length, term);
+	out->length = 0;
+	fflush(term);
+}
+
+void freeOutput(output_t *out)
+{
+	free(out->data);
+	out->data = NULL;
+	out->length = 0;
+	out->size = 0;
+}
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "display_internal.h"
+
+/**
+ * This function creates a pad, a window showing part of a canvas that can
+ * be much larger than the window itself. Everything but the content area
+ * (the boarder) works like any other window.
+ *
+ * @param display the display the pad is shown on
+ * @param boarder TRUE to draw a boarder around the content
+ * @param pos_x the row of the window's content on the display
+ * @param pos_y the column of the window's content on the display
+ * @param dim_x the number of content rows shown
+ * @param dim_y the number of content columns shown
+ * @param rows the number of canvas rows
+ * @param cols the number of canvas columns
+ * @return the new window
+ */
+window_t *newPad(display_t *display,
+				char boarder,
+				int pos_x,
+				int pos_y,
+				int dim_x,
+				int dim_y,
+				int rows,
+				int cols)
+{
+	window_t *window = newWindow(display, boarder, pos_x, pos_y, dim_x, dim_y);
+	if (window == NULL)
+		return NULL;
+	pad_t *pad = (pad_t *)malloc(sizeof(pad_t));
+	pad->dim.x = rows;
+	pad->dim.y = cols;
+	pad->view.x = 0;
+	pad->view.y = 0;
+	pad->chunk_count = (rows + PAD_CHUNK_ROWS - 1) / PAD_CHUNK_ROWS;
+	pad->chunks = (struct pad_chunk_struct **)calloc(pad->chunk_count,
+					sizeof(struct pad_chunk_struct *));
+	window->pad = pad;
+	return window;
+}
+
+void freePad(pad_t *pad)
+{
+	int i;
+	for (i = 0; i < pad->chunk_count; i++)
+	{
+		if (pad->chunks[i] != NULL)
+		{
+			free(pad->chunks[i]->contents);
+			free(pad->chunks[i]);
+		}
+	}
+	free(pad->chunks);
+	free(pad);
+}
+
+/**
+ * This function finds the chunk holding a canvas row, allocating it when
+ * asked to. All planes of a chunk share one allocation.
+ *
+ * @param pad the pad
+ * @param row the canvas row
+ * @param create TRUE to allocate a missing chunk
+ * @return the chunk, NULL if it was never written
+ */
+static struct pad_chunk_struct *padChunk(pad_t *pad, int row, char create)
+{
+	struct pad_chunk_struct **chunk = &pad->chunks[row / PAD_CHUNK_ROWS];
+	if (*chunk != NULL || !create)
+		return *chunk;
+	size_t cells = (size_t)PAD_CHUNK_ROWS * pad->dim.y;
+	char *block = (char *)malloc(cells * 4);
+	*chunk = (struct pad_chunk_struct *)malloc(sizeof(struct pad_chunk_struct));
+	(*chunk)->contents = block;
+	memset(block, '\0', cells);
+	block += cells;
+	(*chunk)->attrs = (attr_t *)block;
+	memset(block, 0, cells);
+	block += cells;
+	(*chunk)->colors = (color_t *)block;
+	memset(block, PALETTE_COLOR, cells);
+	block += cells;
+	(*chunk)->backgrounds = (background_t *)block;
+	memset(block, PALETTE_BACKGROUND, cells);
+	return *chunk;
+}
+
+/**
+ * This function marks the palette slots the canvas cells of a pad hold.
+ *
+ * @param pad the pad
+ * @param live set to TRUE for every slot held
+ */
+void padMarkSlots(pad_t *pad, unsigned char *live)
+{
+	size_t cells = (size_t)PAD_CHUNK_ROWS * pad->dim.y;
+	int i;
+	for (i = 0; i < pad->chunk_count; i++)
+	{
+		struct pad_chunk_struct *chunk = pad->chunks[i];
+		if (chunk == NULL)
+			continue;
+		size_t k;
+		for (k = 0; k < cells; k++)
+		{
+			live[chunk->colors[k]] = TRUE;
+			live[chunk->backgrounds[k]] = TRUE;
+		}
+	}
+}
+
+/**
+ * This function looks up the canvas cell shown at a cell of a pad's
+ * window. Canvas cells that were never written are blank.
+ *
+ * @param window the pad's window
+ * @param i the row in the window, boarder included
+ * @param j the column in the window, boarder included
+ * @param c set to the glyph
+ * @param attr set to the attributes
+ * @param color set to the color palette slot
+ * @param background set to the background palette slot
+ * @return FALSE when the cell is on the boarder rather than the canvas
+ */
+char padCell(window_t *window,
+				int i,
+				int j,
+				char *c,
+				attr_t *attr,
+				color_t *color,
+				background_t *background)
+{
+	int d = window->boarder ? 1: 0;
+	if (i < d || i >= window->dim.x - d || j < d || j >= window->dim.y - d)
+		return FALSE;
+	pad_t *pad = window->pad;
+	int row = pad->view.x + i - d;
+	int col = pad->view.y + j - d;
+	struct pad_chunk_struct *chunk = NULL;
+	if (row < pad->dim.x && col < pad->dim.y)
+		chunk = padChunk(pad, row, FALSE);
+	if (chunk == NULL)
+	{
+		*c = '\0';
+		*attr = 0;
+		*color = PALETTE_COLOR;
+		*background = PALETTE_BACKGROUND;
+		return TRUE;
+	}
+	size_t k = (size_t)(row % PAD_CHUNK_ROWS) * pad->dim.y + col;
+	*c = chunk->contents[k];
+	*attr = chunk->attrs[k];
+	*color = chunk->colors[k];
+	*background = chunk->backgrounds[k];
+	return TRUE;
+}
+
+/**
+ * This function damages the part of a canvas rectangle that is in view.
+ *
+ * @param window the pad's window
+ * @param x0 the first canvas row
+ * @param y0 the first canvas column
+ * @param x1 the row after the last row
+ * @param y1 the column after the last column
+ */
+static void padDamage(window_t *window, int x0, int y0, int x1, int y1)
+{
+	int d = window->boarder ? 1: 0;
+	pad_t *pad = window->pad;
+	x0 += d - pad->view.x;
+	x1 += d - pad->view.x;
+	y0 += d - pad->view.y;
+	y1 += d - pad->view.y;
+	if (x0 < d) x0 = d;
+	if (y0 < d) y0 = d;
+	if (x1 > window->dim.x - d) x1 = window->dim.x - d;
+	if (y1 > window->dim.y - d) y1 = window->dim.y - d;
+	if (x0 < x1 && y0 < y1)
+		windowDamage(window, x0, y0, x1, y1);
+}
+
+/**
+ * This function prints a string onto a pad's canvas with the window's
+ * color, background and attributes. A new line starts again at column y
+ * of the next row; text past the edge of the canvas is dropped.
+ *
+ * @param window the pad's window
+ * @param str the string being printed
+ * @param x the start row on the canvas
+ * @param y the start column on the canvas
+ */
+void padPrint(window_t *window,
+				char *str,
+				int x,
+				int y)
+{
+	pad_t *pad = window->pad;
+	if (pad == NULL || x < 0 || y < 0)
+		return;
+	int first = x;
+	int col = y;
+	int last = y;
+	struct pad_chunk_struct *chunk = NULL;
+	int i;
+	for (i = 0; str[i] != '\0' && x < pad->dim.x; i++)
+	{
+		if (str[i] == '\n')
+		{
+			x++;
+			col = y;
+			chunk = NULL;
+			continue;
+		}
+		if (str[i] == '\r')
+			continue;
+		int end = str[i] == '\t' ? (col + 8) / 8 * 8 : col + 1;
+		if (chunk == NULL)
+			chunk = padChunk(pad, x, TRUE);
+		for (; col < end && col < pad->dim.y; col++)
+		{
+			size_t k = (size_t)(x % PAD_CHUNK_ROWS) * pad->dim.y + col;
+			chunk->contents[k] = str[i] == '\t' ? ' ' : str[i];
+			chunk->attrs[k] = window->attr;
+			chunk->colors[k] = window->color;
+			if (window->setBack)
+				chunk->backgrounds[k] = window->background;
+		}
+		if (col > last)
+			last = col;
+	}
+	padDamage(window, first, y, x + 1, last);
+}
+
+/**
+ * This function fills a rectangle of a pad's canvas, the same way
+ * windowFill fills a window.
+ *
+ * @param window the pad's window
+ * @param planes the FILL_* flags of the planes being written
+ * @param c the char being written
+ * @param color the color being written
+ * @param background the background being written
+ * @param x the first canvas row
+ * @param y the first canvas column
+ * @param rows the number of rows
+ * @param cols the number of columns
+ */
+void padFill(window_t *window,
+				int planes,
+				char c,
+				color_t color,
+				background_t background,
+				int x,
+				int y,
+				int rows,
+				int cols)
+{
+	pad_t *pad = window->pad;
+	if (pad == NULL)
+		return;
+	int x0 = x < 0 ? 0 : x;
+	int y0 = y < 0 ? 0 : y;
+	int x1 = x + rows > pad->dim.x ? pad->dim.x : x + rows;
+	int y1 = y + cols > pad->dim.y ? pad->dim.y : y + cols;
+	if (x0 >= x1 || y0 >= y1)
+		return;
+	color_t color_slot = 0;
+	background_t background_slot = 0;
+	if (planes & FILL_COLOR)
+		color_slot = windowPaletteSlot(window, color);
+	if (planes & FILL_BACKGROUND)
+		background_slot = windowPaletteSlotKeep(window, background, &color_slot, 1);
+	size_t n = (size_t)(y1 - y0);
+	int i;
+	for (i = x0; i < x1; i++)
+	{
+		struct pad_chunk_struct *chunk = padChunk(pad, i, TRUE);
+		size_t k = (size_t)(i % PAD_CHUNK_ROWS) * pad->dim.y + y0;
+		if (planes & FILL_GLYPH)
+			memset(chunk->contents + k, c, n);
+		if (planes & FILL_ATTR)
+			memset(chunk->attrs + k, window->attr, n);
+		if (planes & FILL_COLOR)
+			memset(chunk->colors + k, color_slot, n);
+		if (planes & FILL_BACKGROUND)
+			memset(chunk->backgrounds + k, background_slot, n);
+	}
+	padDamage(window, x0, y0, x1, y1);
+}
+
+/**
+ * This function notes that display rows top to bottom moved up by count
+ * rows, so displayUpdate can scroll the terminal instead of redrawing.
+ * Only one region can scroll per update; a second one cancels the hint
+ * and the rows are simply redrawn.
+ */
+static void padScrollHint(display_t *display, int top, int bottom, int count)
+{
+	scroll_t *scroll = &display->scroll;
+	if (top < 0) top = 0;
+	if (bottom > display->dim.x) bottom = display->dim.x;
+	if (scroll->bottom < 0 || top >= bottom)
+		return;
+	if (scroll->count == 0)
+	{
+		scroll->top = top;
+		scroll->bottom = bottom;
+		scroll->count = count;
+	}
+	else if (scroll->top == top && scroll->bottom == bottom)
+	{
+		scroll->count += count;
+	}
+	else
+	{
+		scroll->count = 0;
+		scroll->bottom = -1;
+	}
+}
+
+/**
+ * This function moves the part of the canvas a pad shows, so that canvas
+ * cell x, y is at the top left of the content. Nothing is copied; the
+ * content is damaged and drawn from the canvas at the next update.
+ * The view is kept inside the canvas.
+ *
+ * @param window the pad's window
+ * @param x the first canvas row shown
+ * @param y the first canvas column shown
+ */
+void padSetView(window_t *window, int x, int y)
+{
+	pad_t *pad = window->pad;
+	if (pad == NULL)
+		return;
+	int d = window->boarder ? 1: 0;
+	int max_x = pad->dim.x - (window->dim.x - 2 * d);
+	int max_y = pad->dim.y - (window->dim.y - 2 * d);
+	if (x > max_x) x = max_x;
+	if (y > max_y) y = max_y;
+	if (x < 0) x = 0;
+	if (y < 0) y = 0;
+	if (x == pad->view.x && y == pad->view.y)
+		return;
+	if (y == pad->view.y && !window->hidden)
+		padScrollHint(window->display, window->pos.x + d,
+					window->pos.x + window->dim.x - d, x - pad->view.x);
+	pad->view.x = x;
+	pad->view.y = y;
+	windowDamage(window, d, d, window->dim.x - d, window->dim.y - d);
+}
+
+/**
+ * This function scrolls a pad's view by a number of rows, down the canvas
+ * when rows is positive and up when it is negative.
+ *
+ * @param window the pad's window
+ * @param rows the number of rows
+ */
+void padScroll(window_t *window, int rows)
+{
+	if (window->pad != NULL)
+		padSetView(window, window->pad->view.x + rows, window->pad->view.y);
+}
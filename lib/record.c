@@ -0,0 +1,482 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "display_internal.h"
+
+#define RECORD_MAGIC "TXTREC01"
+#define RECORD_BUFFER_SIZE (1024 * 1024)
+#define RECORD_KEYFRAME_INTERVAL 300
+
+enum frame_type_enum
+{
+	FRAME_DELTA = 1,
+	FRAME_KEY = 2
+};
+
+/**
+ * A recording is a file header followed by frames. Delta frames hold runs
+ * of changed cells; key frames hold every cell so a replay can start from
+ * them without reading what came before.
+ */
+struct record_header_struct
+{
+	char magic[8];
+	uint32_t keyframe_interval;
+	uint32_t planes; // the FILL_COLOR and FILL_BACKGROUND planes drawn
+};
+
+struct frame_header_struct
+{
+	uint32_t type;
+	uint32_t length;
+	uint64_t time;
+};
+
+struct run_header_struct
+{
+	uint16_t row;
+	uint16_t col;
+	uint16_t count;
+	uint16_t reserved;
+};
+
+struct key_header_struct
+{
+	uint16_t rows;
+	uint16_t cols;
+	uint32_t reserved;
+};
+
+/**
+ * Frames are appended to the active buffer by the thread drawing the
+ * display. Once the buffer is full enough it is handed to the writer
+ * thread and the other buffer becomes active, so the frame path never
+ * waits on the disk. If the writer is still busy with the other buffer
+ * the active one just keeps growing.
+ */
+struct recorder_struct
+{
+	FILE *file;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	output_t buffers[2];
+	char busy[2];
+	int active;
+	char stopping;
+	size_t frame_start;
+	unsigned long frames;
+	int keyframe_interval;
+	int rows;
+	int cols;
+};
+
+static uint64_t recordTime(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void *recordWriter(void *arg)
+{
+	recorder_t *recorder = (recorder_t *)arg;
+	pthread_mutex_lock(&recorder->lock);
+	for (;;)
+	{
+		int i = recorder->busy[0] ? 0 : recorder->busy[1] ? 1 : -1;
+		if (i < 0)
+		{
+			if (recorder->stopping)
+				break;
+			pthread_cond_wait(&recorder->cond, &recorder->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&recorder->lock);
+		output_t *buffer = &recorder->buffers[i];
+		fwrite(buffer->data, 1, buffer->length, recorder->file);
+		fflush(recorder->file);
+		buffer->length = 0;
+		pthread_mutex_lock(&recorder->lock);
+		recorder->busy[i] = FALSE;
+		pthread_cond_broadcast(&recorder->cond);
+	}
+	pthread_mutex_unlock(&recorder->lock);
+	return NULL;
+}
+
+/**
+ * This function hands the active buffer to the writer if it is free to
+ * take it.
+ *
+ * @param recorder the recorder
+ * @param wait TRUE to wait for the writer instead of giving up
+ */
+static void recordHandOff(recorder_t *recorder, char wait)
+{
+	int other = !recorder->active;
+	pthread_mutex_lock(&recorder->lock);
+	while (wait && recorder->busy[other])
+		pthread_cond_wait(&recorder->cond, &recorder->lock);
+	if (!recorder->busy[other])
+	{
+		recorder->busy[recorder->active] = TRUE;
+		recorder->active = other;
+		pthread_cond_broadcast(&recorder->cond);
+	}
+	pthread_mutex_unlock(&recorder->lock);
+}
+
+/**
+ * This function starts recording every frame a display sends.
+ * Each frame is stored as the cells it changed, with a key frame holding
+ * the whole screen every few hundred frames and after a resize.
+ * The recording is written by a background thread.
+ *
+ * @param display the display being recorded
+ * @param path the recording file
+ * @return 0 on success, -1 if the file could not be opened
+ */
+int displayStartRecording(display_t *display, const char *path)
+{
+	if (display->recorder != NULL)
+		displayStopRecording(display);
+
+	FILE *file = fopen(path, "wb");
+	if (file == NULL)
+		return -1;
+
+	recorder_t *recorder = (recorder_t *)calloc(1, sizeof(recorder_t));
+	recorder->file = file;
+	recorder->keyframe_interval = RECORD_KEYFRAME_INTERVAL;
+	recorder->rows = -1;
+	recorder->cols = -1;
+	int i;
+	for (i = 0; i < 2; i++)
+	{
+		recorder->buffers[i].data = (char *)malloc(RECORD_BUFFER_SIZE);
+		recorder->buffers[i].size = RECORD_BUFFER_SIZE;
+	}
+
+	struct record_header_struct header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+	header.keyframe_interval = recorder->keyframe_interval;
+	header.planes = displayDrawnPlanes(display);
+	outputWrite(&recorder->buffers[0], (const char *)&header, sizeof(header));
+
+	pthread_mutex_init(&recorder->lock, NULL);
+	pthread_cond_init(&recorder->cond, NULL);
+	pthread_create(&recorder->thread, NULL, recordWriter, recorder);
+	display->recorder = recorder;
+	return 0;
+}
+
+/**
+ * This function stops recording a display, waiting for everything
+ * recorded to reach the file.
+ *
+ * @param display the display being recorded
+ */
+void displayStopRecording(display_t *display)
+{
+	recorder_t *recorder = display->recorder;
+	if (recorder == NULL)
+		return;
+	display->recorder = NULL;
+
+	if (recorder->buffers[recorder->active].length > 0)
+		recordHandOff(recorder, TRUE);
+	pthread_mutex_lock(&recorder->lock);
+	recorder->stopping = TRUE;
+	pthread_cond_broadcast(&recorder->cond);
+	pthread_mutex_unlock(&recorder->lock);
+	pthread_join(recorder->thread, NULL);
+
+	fclose(recorder->file);
+	pthread_mutex_destroy(&recorder->lock);
+	pthread_cond_destroy(&recorder->cond);
+	freeOutput(&recorder->buffers[0]);
+	freeOutput(&recorder->buffers[1]);
+	free(recorder);
+}
+
+static void recordFrameHeader(recorder_t *recorder, uint32_t type)
+{
+	struct frame_header_struct header = {type, 0, 0};
+	output_t *buffer = &recorder->buffers[recorder->active];
+	recorder->frame_start = buffer->length;
+	outputWrite(buffer, (const char *)&header, sizeof(header));
+}
+
+static void recordFrameEnd(recorder_t *recorder, uint64_t time)
+{
+	output_t *buffer = &recorder->buffers[recorder->active];
+	struct frame_header_struct *header =
+		(struct frame_header_struct *)(buffer->data + recorder->frame_start);
+	header->length = buffer->length - recorder->frame_start - sizeof(*header);
+	header->time = time;
+}
+
+/**
+ * This function opens a delta frame. Called before the rows of a frame are
+ * encoded.
+ *
+ * @param recorder the recorder
+ */
+void recordBeginFrame(recorder_t *recorder)
+{
+	recordFrameHeader(recorder, FRAME_DELTA);
+}
+
+/**
+ * This function records the cells of a row that are about to change.
+ *
+ * @param recorder the recorder
+ * @param known the row the terminal shows
+ * @param next the row being drawn, valid from start to end
+ * @param row the row number
+ * @param start the first column that may have changed
+ * @param end the column after the last column that may have changed
+ */
+void recordRow(recorder_t *recorder,
+				const cell_t *known,
+				const cell_t *next,
+				int row,
+				int start,
+				int end)
+{
+	output_t *buffer = &recorder->buffers[recorder->active];
+	int j = start;
+	while (j < end)
+	{
+		if (cellEqual(&known[j], &next[j]))
+		{
+			j++;
+			continue;
+		}
+		int k = j + 1;
+		while (k < end && !cellEqual(&known[k], &next[k]))
+			k++;
+		struct run_header_struct run = {row, j, k - j, 0};
+		outputWrite(buffer, (const char *)&run, sizeof(run));
+		outputWrite(buffer, (const char *)&next[j], sizeof(cell_t) * (k - j));
+		j = k;
+	}
+}
+
+/**
+ * This function closes the frame opened by recordBeginFrame, adding a key
+ * frame when one is due. Empty delta frames are dropped.
+ *
+ * @param recorder the recorder
+ * @param display the display, holding the frame just sent
+ */
+void recordEndFrame(recorder_t *recorder, display_t *display)
+{
+	output_t *buffer = &recorder->buffers[recorder->active];
+	uint64_t time = recordTime();
+	if (buffer->length == recorder->frame_start + sizeof(struct frame_header_struct))
+		buffer->length = recorder->frame_start;
+	else
+		recordFrameEnd(recorder, time);
+
+	if (recorder->frames % recorder->keyframe_interval == 0
+		|| recorder->rows != display->dim.x || recorder->cols != display->dim.y)
+	{
+		struct key_header_struct key = {display->dim.x, display->dim.y, 0};
+		recordFrameHeader(recorder, FRAME_KEY);
+		buffer = &recorder->buffers[recorder->active];
+		outputWrite(buffer, (const char *)&key, sizeof(key));
+		outputWrite(buffer, (const char *)display->current[0],
+				sizeof(cell_t) * display->dim.x * display->dim.y);
+		recordFrameEnd(recorder, time);
+		recorder->rows = display->dim.x;
+		recorder->cols = display->dim.y;
+	}
+	recorder->frames++;
+
+	if (buffer->length >= RECORD_BUFFER_SIZE / 2)
+		recordHandOff(recorder, FALSE);
+}
+
+/**
+ * This function opens a recording for replay.
+ * The frame headers are read once to find the key frames, so seeking only
+ * reads from the closest key frame on.
+ *
+ * @param path the recording file
+ * @return the replay, NULL if the file is not a recording
+ */
+replay_t *openReplay(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+		return NULL;
+	struct record_header_struct header;
+	if (fread(&header, sizeof(header), 1, file) != 1
+		|| memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) != 0)
+	{
+		fclose(file);
+		return NULL;
+	}
+
+	replay_t *replay = (replay_t *)calloc(1, sizeof(replay_t));
+	replay->file = file;
+	replay->planes = header.planes;
+	int capacity = 0;
+	struct frame_header_struct frame;
+	long offset = ftell(file);
+	while (fread(&frame, sizeof(frame), 1, file) == 1)
+	{
+		if (replay->frames == 0)
+			replay->start = frame.time;
+		replay->end = frame.time;
+		replay->frames++;
+		if (frame.type == FRAME_KEY)
+		{
+			if (replay->keys == capacity)
+			{
+				capacity = capacity ? capacity * 2 : 64;
+				replay->key_offsets = (long *)realloc(replay->key_offsets, sizeof(long) * capacity);
+				replay->key_times = (uint64_t *)realloc(replay->key_times, sizeof(uint64_t) * capacity);
+			}
+			replay->key_offsets[replay->keys] = offset;
+			replay->key_times[replay->keys] = frame.time;
+			replay->keys++;
+		}
+		if (fseek(file, frame.length, SEEK_CUR) != 0)
+			break;
+		offset = ftell(file);
+	}
+	replay->first = sizeof(header);
+	fseek(file, replay->first, SEEK_SET);
+	return replay;
+}
+
+void freeReplay(replay_t *replay)
+{
+	fclose(replay->file);
+	free(replay->key_offsets);
+	free(replay->key_times);
+	free(replay->payload);
+	free(replay->cells);
+	free(replay->damage);
+	free(replay);
+}
+
+static void replayDamage(replay_t *replay, int row, int start, int end)
+{
+	span_t *span = &replay->damage[row];
+	if (span->start >= span->end)
+	{
+		span->start = start;
+		span->end = end;
+		return;
+	}
+	if (start < span->start) span->start = start;
+	if (end > span->end) span->end = end;
+}
+
+static void replayKey(replay_t *replay, const char *payload, size_t length)
+{
+	struct key_header_struct key;
+	if (length < sizeof(key))
+		return;
+	memcpy(&key, payload, sizeof(key));
+	if (length < sizeof(key) + sizeof(cell_t) * key.rows * key.cols)
+		return;
+	if (key.rows != replay->rows || key.cols != replay->cols)
+	{
+		free(replay->cells);
+		free(replay->damage);
+		replay->rows = key.rows;
+		replay->cols = key.cols;
+		replay->cells = (cell_t *)malloc(sizeof(cell_t) * key.rows * key.cols);
+		replay->damage = (span_t *)calloc(key.rows, sizeof(span_t));
+		replay->resized = TRUE;
+	}
+	memcpy(replay->cells, payload + sizeof(key), sizeof(cell_t) * key.rows * key.cols);
+	int i;
+	for (i = 0; i < replay->rows; i++)
+		replayDamage(replay, i, 0, replay->cols);
+}
+
+static void replayDelta(replay_t *replay, const char *payload, size_t length)
+{
+	size_t at = 0;
+	struct run_header_struct run;
+	while (at + sizeof(run) <= length)
+	{
+		memcpy(&run, payload + at, sizeof(run));
+		at += sizeof(run);
+		if (at + sizeof(cell_t) * run.count > length)
+			return;
+		if (run.row < replay->rows && run.col + run.count <= replay->cols)
+		{
+			memcpy(replay->cells + (size_t)run.row * replay->cols + run.col,
+					payload + at, sizeof(cell_t) * run.count);
+			replayDamage(replay, run.row, run.col, run.col + run.count);
+		}
+		at += sizeof(cell_t) * run.count;
+	}
+}
+
+/**
+ * This function applies the next frame of a replay to its cells.
+ * The rows it changed are added to the replay damage.
+ *
+ * @param replay the replay
+ * @return 1 when a frame was applied, 0 at the end of the recording
+ */
+int replayNext(replay_t *replay)
+{
+	struct frame_header_struct frame;
+	if (fread(&frame, sizeof(frame), 1, replay->file) != 1)
+		return 0;
+	if (frame.length > replay->payload_size)
+	{
+		replay->payload = (char *)realloc(replay->payload, frame.length);
+		replay->payload_size = frame.length;
+	}
+	if (fread(replay->payload, 1, frame.length, replay->file) != frame.length)
+		return 0;
+	if (frame.type == FRAME_KEY)
+		replayKey(replay, replay->payload, frame.length);
+	else if (replay->cells != NULL)
+		replayDelta(replay, replay->payload, frame.length);
+	replay->time = frame.time;
+	return 1;
+}
+
+/**
+ * This function moves a replay to the screen as it was at a time,
+ * starting from the last key frame before it.
+ *
+ * @param replay the replay
+ * @param time the time, in microseconds since the epoch
+ * @return 1 on success, 0 if the recording has no key frame
+ */
+int replaySeek(replay_t *replay, uint64_t time)
+{
+	if (replay->keys == 0)
+		return 0;
+	int i = 0;
+	while (i + 1 < replay->keys && replay->key_times[i + 1] <= time)
+		i++;
+	fseek(replay->file, replay->key_offsets[i], SEEK_SET);
+	replayNext(replay);
+
+	struct frame_header_struct frame;
+	for (;;)
+	{
+		long offset = ftell(replay->file);
+		if (fread(&frame, sizeof(frame), 1, replay->file) != 1)
+			break;
+		fseek(replay->file, offset, SEEK_SET);
+		if (frame.time > time || !replayNext(replay))
+			break;
+	}
+	return 1;
+}
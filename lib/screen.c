@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "display_internal.h"
+
+/**
+ * This function builds the record of what the terminal shows, every cell
+ * zeroed so nothing matches it until it is drawn.
+ */
+static cell_t **buildKnown(int rows, int cols)
+{
+	cell_t **known = (cell_t **)malloc(sizeof(cell_t *) * rows
+					+ sizeof(cell_t) * rows * cols);
+	cell_t *cells = (cell_t *)(known + rows);
+	memset(cells, 0, sizeof(cell_t) * rows * cols);
+	int i;
+	for (i = 0; i < rows; i++)
+		known[i] = cells + (size_t)i * cols;
+	return known;
+}
+
+/**
+ * This function builds a screen set, a terminal shared by several pages.
+ * Pages are displays made with screenSetAddPage; one of them is shown at
+ * a time and the others keep their frames up to date without drawing.
+ *
+ * @param term the terminal to display on
+ * @param rows the number of rows to display
+ * @param cols the number of columns to display
+ * @return the new screen set
+ */
+screen_set_t *newScreenSet(FILE *term, int rows, int cols)
+{
+	screen_set_t *set = (screen_set_t *)malloc(sizeof(screen_set_t));
+	set->term = term;
+	set->profile = terminalDetect(&set->color_depth);
+	set->known = buildKnown(rows, cols);
+	set->dim.x = rows;
+	set->dim.y = cols;
+	set->pages = NULL;
+	set->count = 0;
+	set->size = 0;
+	set->active = NULL;
+	set->hidden = FALSE;
+	fputs(set->profile->clear, term);
+	fputs(set->profile->cursor_hide, term);
+	fflush(term);
+	return set;
+}
+
+/**
+ * This function adds a page to a screen set. A page is a display like any
+ * other, but it only draws while it is the page shown. It takes the set's
+ * profile and color depth, since every page draws on the same terminal.
+ * The first page added is shown, unless the set was hidden.
+ * Pages are freed with freeDisplay, or all at once by freeScreenSet.
+ *
+ * @param set the screen set
+ * @return the new page
+ */
+display_t *screenSetAddPage(screen_set_t *set)
+{
+	char valid;
+	display_t *page = displayCreate(set->term, set->dim.x, set->dim.y, NULL, &valid);
+	page->screens = set;
+	page->profile = set->profile;
+	displaySetColorDepth(page, set->color_depth);
+	if (set->count == set->size)
+	{
+		set->size = set->size ? set->size * 2 : 4;
+		set->pages = (display_t **)realloc(set->pages, sizeof(display_t *) * set->size);
+	}
+	set->pages[set->count++] = page;
+	if (set->active == NULL && !set->hidden)
+		set->active = page;
+	return page;
+}
+
+/**
+ * This function takes a page out of its screen set.
+ *
+ * @param set the screen set
+ * @param page the page
+ */
+void screenSetRemovePage(screen_set_t *set, display_t *page)
+{
+	int i;
+	for (i = 0; i < set->count; i++)
+	{
+		if (set->pages[i] == page)
+		{
+			set->pages[i] = set->pages[--set->count];
+			break;
+		}
+	}
+	if (set->active == page)
+		set->active = NULL;
+	page->screens = NULL;
+}
+
+/**
+ * This function switches the page shown. The page's frame is brought up
+ * to date without drawing, then only the cells where it differs from what
+ * the terminal shows are sent.
+ *
+ * @param set the screen set
+ * @param page the page to show
+ */
+void screenSetShow(screen_set_t *set, display_t *page)
+{
+	if (page->screens != set || set->active == page)
+		return;
+	set->active = NULL;
+	displayUpdate(page);
+	set->active = page;
+	if (set->hidden)
+	{
+		fputs(set->profile->cursor_hide, set->term);
+		set->hidden = FALSE;
+	}
+
+	encoder_t enc;
+	int i;
+	encodeBegin(&enc, page, &page->out);
+	for (i = 0; i < set->dim.x; i++)
+		encodeRow(&enc, set->known[i], page->current[i], i, 0, set->dim.y);
+	encodeEnd(&enc);
+	outputFlush(&page->out, set->term);
+}
+
+/**
+ * This function hands the terminal back from a screen set, with the
+ * cursor shown below the screen. No page is shown until screenSetShow;
+ * as the terminal may be written to meanwhile, what it shows is forgotten
+ * and the next page shown is drawn whole.
+ *
+ * @param set the screen set
+ */
+void screenSetHide(screen_set_t *set)
+{
+	if (set->hidden)
+		return;
+	set->active = NULL;
+	set->hidden = TRUE;
+	memset(set->known[0], 0, sizeof(cell_t) * set->dim.x * set->dim.y);
+	fprintf(set->term, "\033[%d;1H", set->dim.x + 1);
+	fputs(set->profile->cursor_show, set->term);
+	fflush(set->term);
+}
+
+/**
+ * This function changes the size of a screen set and all of its pages.
+ * The screen is cleared and the page shown is drawn whole at its next
+ * update.
+ *
+ * @param set the screen set
+ * @param rows the number of rows to display
+ * @param cols the number of columns to display
+ */
+void screenSetSize(screen_set_t *set, int rows, int cols)
+{
+	if (rows == set->dim.x && cols == set->dim.y)
+		return;
+	free(set->known);
+	set->known = buildKnown(rows, cols);
+	set->dim.x = rows;
+	set->dim.y = cols;
+	int i;
+	for (i = 0; i < set->count; i++)
+		displaySetSize(set->pages[i], rows, cols);
+	fputs(set->profile->clear, set->term);
+	fflush(set->term);
+}
+
+/**
+ * This function frees a screen set and every page still in it, leaving
+ * the terminal cleared.
+ *
+ * @param set the screen set
+ */
+void freeScreenSet(screen_set_t *set)
+{
+	while (set->count > 0)
+		freeDisplay(set->pages[set->count - 1]);
+	fputs(set->profile->clear, set->term);
+	fprintf(set->term, "\033[1;1H");
+	fputs(set->profile->cursor_show, set->term);
+	fflush(set->term);
+	free(set->known);
+	free(set->pages);
+	free(set);
+}
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "display_internal.h"
+
+#define SINK_PENDING_LIMIT (256 * 1024)
+
+/**
+ * This function writes as much as a sink takes without blocking.
+ *
+ * @param sink the sink
+ * @param data the bytes being sent
+ * @param length the number of bytes
+ * @return the number of bytes taken, -1 once the sink is closed
+ */
+static ssize_t sinkWrite(sink_t *sink, const char *data, size_t length)
+{
+	size_t done = 0;
+	while (done < length)
+	{
+		ssize_t n = send(sink->fd, data + done, length - done, MSG_NOSIGNAL);
+		if (n < 0 && errno == ENOTSOCK)
+			n = write(sink->fd, data + done, length - done);
+		if (n > 0)
+		{
+			done += n;
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		sink->closed = TRUE;
+		return -1;
+	}
+	return done;
+}
+
+/**
+ * This function sends bytes to a sink, queueing what it does not take yet
+ * behind anything already queued.
+ *
+ * @param sink the sink
+ * @param data the bytes being sent
+ * @param length the number of bytes
+ */
+static void sinkSend(sink_t *sink, const char *data, size_t length)
+{
+	if (sink->closed)
+		return;
+	if (sink->pending.length == 0)
+	{
+		ssize_t n = sinkWrite(sink, data, length);
+		if (n < 0)
+			return;
+		data += n;
+		length -= n;
+	}
+	if (length > 0)
+		outputWrite(&sink->pending, data, length);
+}
+
+/**
+ * This function sends a sink the difference between what it shows and the
+ * current frame, bringing it back in step with the others.
+ *
+ * @param display the display
+ * @param sink the sink
+ */
+static void sinkCatchUp(display_t *display, sink_t *sink)
+{
+	output_t out = {NULL, 0, 0};
+	encoder_t enc;
+	int i;
+	int cols = display->dim.y;
+	if (sink->fresh)
+	{
+		outputString(&out, display->profile->clear);
+		outputString(&out, display->profile->cursor_hide);
+		sink->fresh = FALSE;
+	}
+	encodeBegin(&enc, display, &out);
+	for (i = 0; i < display->dim.x; i++)
+	{
+		encodeRow(&enc, sink->known + (size_t)i * cols, display->current[i], i, 0, cols);
+	}
+	encodeEnd(&enc);
+	sinkSend(sink, out.data, out.length);
+	freeOutput(&out);
+	sink->synced = TRUE;
+}
+
+/**
+ * This function drains what a sink has queued.
+ *
+ * @param sink the sink
+ */
+static void sinkDrain(sink_t *sink)
+{
+	if (sink->closed || sink->pending.length == 0)
+		return;
+	ssize_t n = sinkWrite(sink, sink->pending.data, sink->pending.length);
+	if (n <= 0)
+		return;
+	memmove(sink->pending.data, sink->pending.data + n, sink->pending.length - n);
+	sink->pending.length -= n;
+}
+
+/**
+ * This function adds a viewer to a display.
+ * Every frame is composed and encoded once and the same bytes are sent to
+ * the terminal and every sink, which can be a pty or a connected socket.
+ * Sinks are written without blocking. A sink that falls too far behind
+ * stops receiving frames and gets a single catch-up frame once it has
+ * drained, and a new sink starts with one, so no viewer holds up another.
+ * Pages of a screen set share their terminal and cannot have sinks.
+ *
+ * @param display the display being shown
+ * @param fd the file descriptor of the viewer
+ * @return the new sink, NULL for a page of a screen set
+ */
+sink_t *displayAddSink(display_t *display, int fd)
+{
+	if (display->screens != NULL)
+		return NULL;
+	sink_t *sink = (sink_t *)malloc(sizeof(sink_t));
+	sink->fd = fd;
+	sink->known = (cell_t *)calloc((size_t)display->dim.x * display->dim.y, sizeof(cell_t));
+	sink->pending.data = NULL;
+	sink->pending.length = 0;
+	sink->pending.size = 0;
+	sink->synced = FALSE;
+	sink->fresh = TRUE;
+	sink->closed = FALSE;
+	sink->next = display->sinks;
+	display->sinks = sink;
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	return sink;
+}
+
+/**
+ * This function removes a viewer from a display.
+ * The file descriptor is left open.
+ *
+ * @param display the display
+ * @param sink the sink being removed
+ */
+void displayRemoveSink(display_t *display, sink_t *sink)
+{
+	sink_t **link;
+	for (link = &display->sinks; *link != NULL; link = &(*link)->next)
+	{
+		if (*link == sink)
+		{
+			*link = sink->next;
+			break;
+		}
+	}
+	freeOutput(&sink->pending);
+	free(sink->known);
+	free(sink);
+}
+
+/**
+ * This function sends what the sinks of a display have queued and catches
+ * up the ones that have drained. Programs waiting on the sinks becoming
+ * writable can call it between frames.
+ *
+ * @param display the display
+ */
+void displayFlushSinks(display_t *display)
+{
+	sink_t *sink;
+	for (sink = display->sinks; sink != NULL; sink = sink->next)
+	{
+		sinkDrain(sink);
+		if (!sink->closed && !sink->synced && sink->pending.length == 0)
+			sinkCatchUp(display, sink);
+	}
+}
+
+/**
+ * This function is called before a frame is encoded. Sinks too far behind
+ * are dropped out of step, remembering the frame they will show once
+ * drained, which is the one in display->current right now.
+ *
+ * @param display the display
+ */
+void sinksBeginFrame(display_t *display)
+{
+	sink_t *sink;
+	for (sink = display->sinks; sink != NULL; sink = sink->next)
+	{
+		sinkDrain(sink);
+		if (sink->synced && sink->pending.length > SINK_PENDING_LIMIT)
+		{
+			memcpy(sink->known, display->current[0],
+					sizeof(cell_t) * display->dim.x * display->dim.y);
+			sink->synced = FALSE;
+		}
+	}
+}
+
+/**
+ * This function fans an encoded frame out to every sink in step, then
+ * catches up the ones that are not.
+ *
+ * @param display the display
+ * @param data the encoded frame
+ * @param length the number of bytes
+ */
+void sinksEndFrame(display_t *display, const char *data, size_t length)
+{
+	sink_t *sink;
+	for (sink = display->sinks; sink != NULL; sink = sink->next)
+	{
+		if (sink->synced)
+			sinkSend(sink, data, length);
+	}
+	displayFlushSinks(display);
+}
+
+/**
+ * This function forgets what every sink shows after the display changed
+ * size, so each gets a full catch-up frame.
+ *
+ * @param display the display
+ */
+void sinksResize(display_t *display)
+{
+	sink_t *sink;
+	for (sink = display->sinks; sink != NULL; sink = sink->next)
+	{
+		free(sink->known);
+		sink->known = (cell_t *)calloc((size_t)display->dim.x * display->dim.y, sizeof(cell_t));
+		sink->synced = FALSE;
+		sink->fresh = TRUE;
+	}
+}
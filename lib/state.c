@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "display_internal.h"
+
+#define STATE_MAGIC "TXTDSP01"
+
+/**
+ * The state file holds the cells the terminal is known to show, behind a
+ * header describing the terminal they were drawn on.
+ * The generation is odd while a frame is being sent, so a process that
+ * died half way through a frame leaves a state that will not be trusted.
+ */
+struct state_struct
+{
+	char magic[8];
+	int rows;
+	int cols;
+	int term_rows;
+	int term_cols;
+	unsigned int cell_size;
+	unsigned int generation;
+};
+
+static void terminalSize(display_t *display, int *rows, int *cols)
+{
+	struct winsize w;
+	*rows = 0;
+	*cols = 0;
+	if (ioctl(fileno(display->term), TIOCGWINSZ, &w) == 0)
+	{
+		*rows = w.ws_row;
+		*cols = w.ws_col;
+	}
+}
+
+/**
+ * This function maps the state file of a display.
+ * The file is created or resized when it does not hold a state of the right
+ * size. A state is only trusted when it was drawn with the same display
+ * size on a terminal of the same size and no frame was left half sent;
+ * otherwise its cells are zeroed, which never match a rendered cell.
+ *
+ * @param display the display with state_path set
+ * @param rows the number of display rows
+ * @param cols the number of display columns
+ * @param valid set to TRUE when the cells match the terminal
+ * @return the mapped cells, NULL if the file could not be mapped
+ */
+cell_t *stateAttach(display_t *display, int rows, int cols, char *valid)
+{
+	*valid = FALSE;
+	size_t size = sizeof(struct state_struct) + sizeof(cell_t) * rows * cols;
+	int fd = open(display->state_path, O_RDWR | O_CREAT, 0600);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || ((size_t)st.st_size != size && ftruncate(fd, size) != 0))
+	{
+		close(fd);
+		return NULL;
+	}
+	struct state_struct *state = (struct state_struct *)mmap(NULL, size,
+				PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (state == MAP_FAILED)
+		return NULL;
+
+	int term_rows, term_cols;
+	terminalSize(display, &term_rows, &term_cols);
+	cell_t *cells = (cell_t *)(state + 1);
+	if ((size_t)st.st_size == size
+		&& memcmp(state->magic, STATE_MAGIC, sizeof(state->magic)) == 0
+		&& state->rows == rows && state->cols == cols
+		&& state->term_rows == term_rows && state->term_cols == term_cols
+		&& state->cell_size == sizeof(cell_t)
+		&& (state->generation & 1) == 0)
+	{
+		*valid = TRUE;
+	}
+	else
+	{
+		memcpy(state->magic, STATE_MAGIC, sizeof(state->magic));
+		state->rows = rows;
+		state->cols = cols;
+		state->term_rows = term_rows;
+		state->term_cols = term_cols;
+		state->cell_size = sizeof(cell_t);
+		state->generation = 0;
+		memset(cells, 0, sizeof(cell_t) * rows * cols);
+	}
+
+	display->state = state;
+	display->state_size = size;
+	return cells;
+}
+
+/**
+ * This function unmaps the state file of a display, leaving the file for
+ * the next process.
+ *
+ * @param display the display
+ */
+void stateDetach(display_t *display)
+{
+	if (display->state == NULL)
+		return;
+	munmap(display->state, display->state_size);
+	display->state = NULL;
+	display->state_size = 0;
+}
+
+/**
+ * This function marks the state as being changed by a frame in flight.
+ *
+ * @param display the display
+ */
+void stateBegin(display_t *display)
+{
+	if (display->state != NULL)
+		display->state->generation |= 1;
+}
+
+/**
+ * This function marks the frame in flight as sent.
+ *
+ * @param display the display
+ */
+void stateCommit(display_t *display)
+{
+	if (display->state != NULL)
+		display->state->generation++;
+}
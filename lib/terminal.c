@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+#include "display.h"
+
+#define XTERM_CAPS (CAP_EL | CAP_ECH | CAP_REP | CAP_BCE | CAP_SCROLL_REGION \
+				| CAP_ALT_SCREEN | CAP_DECCRA)
+#define MODERN_CAPS (CAP_EL | CAP_ECH | CAP_REP | CAP_BCE | CAP_SCROLL_REGION \
+				| CAP_ALT_SCREEN | CAP_SYNC)
+
+#define DEC_HIDE "\033[?25l"
+#define DEC_SHOW "\033[?25h"
+#define DEC_SAVE "\0337"
+#define DEC_RESTORE "\0338"
+
+/**
+ * The compiled in terminal table.
+ * Entries are matched against the start of TERM and the longest match wins,
+ * so "xterm-kitty" beats "xterm". The last entry is the fallback.
+ */
+static const term_profile_t profiles[] = {
+	{"xterm-kitty", MODERN_CAPS, COLOR_DEPTH_TRUE,
+		"\033[2J", DEC_HIDE, DEC_SHOW, DEC_SAVE, DEC_RESTORE},
+	{"xterm-ghostty", MODERN_CAPS, COLOR_DEPTH_TRUE,
+		"\033[2J", DEC_HIDE, DEC_SHOW, DEC_SAVE, DEC_RESTORE},
+	{"foot", MODERN_CAPS, COLOR_DEPTH_TRUE,
+		"\033[2J", DEC_HIDE, DEC_SHOW, DEC_SAVE, DEC_RESTORE},
+	{"wezterm", MODERN_CAPS, COLOR_DEPTH_TRUE,
+		"\033[2J", DEC_HIDE, DEC_SHOW, DEC_SAVE, DEC_RESTORE},
+	{"alacritty", MODERN_CAPS & ~CAP_REP, COLOR_DEPTH_TRUE,
+		"\033[2J", DEC_HIDE, DEC_SHOW, DEC_SAVE, DEC_RESTORE},
+	{"xterm", XTERM_CAPS, COLOR_DEPTH_16,
+		"\033[2J", DEC_HIDE, DEC_SHOW, DEC_SAVE, DEC_RESTORE},
+	{"tmux", CAP_EL | CAP_ECH | CAP_REP | CAP_SCROLL_REGION | CAP_ALT_SCREEN | CAP_SYNC,
+		COLOR_DEPTH_256, "\033[2J", DEC_HIDE, DEC_SHOW, DEC_SAVE, DEC_RESTORE},
+	{"screen", CAP_EL | CAP_ECH | CAP_SCROLL_REGION | CAP_ALT_SCREEN, COLOR_DEPTH_16,
+		"\033[2J", DEC_HIDE, DEC_SHOW, DEC_SAVE, DEC_RESTORE},
+	{"linux", CAP_EL | CAP_ECH | CAP_BCE | CAP_SCROLL_REGION, COLOR_DEPTH_16,
+		"\033[2J", DEC_HIDE, DEC_SHOW, DEC_SAVE, DEC_RESTORE},
+	{"vt220", CAP_EL | CAP_ECH | CAP_SCROLL_REGION, COLOR_DEPTH_MONO,
+		"\033[2J", DEC_HIDE, DEC_SHOW, DEC_SAVE, DEC_RESTORE},
+	{"vt100", CAP_EL | CAP_SCROLL_REGION, COLOR_DEPTH_MONO,
+		"\033[2J", "", "", DEC_SAVE, DEC_RESTORE},
+	{"vt102", CAP_EL | CAP_SCROLL_REGION, COLOR_DEPTH_MONO,
+		"\033[2J", "", "", DEC_SAVE, DEC_RESTORE},
+	{"ansi", CAP_EL | CAP_BCE, COLOR_DEPTH_16,
+		"\033[2J", "", "", "\033[s", "\033[u"},
+	{"", CAP_EL | CAP_SCROLL_REGION, COLOR_DEPTH_16,
+		"\033[2J", DEC_HIDE, DEC_SHOW, DEC_SAVE, DEC_RESTORE}
+};
+
+#define PROFILE_COUNT (sizeof(profiles) / sizeof(profiles[0]))
+
+/**
+ * This function looks up the output profile of a terminal type.
+ *
+ * @param term the terminal type, as found in TERM (may be NULL)
+ * @return the profile, never NULL
+ */
+const term_profile_t *terminalProfile(const char *term)
+{
+	const term_profile_t *best = &profiles[PROFILE_COUNT - 1];
+	size_t best_len = 0;
+	size_t i;
+	if (term == NULL)
+		return best;
+	for (i = 0; i < PROFILE_COUNT - 1; i++)
+	{
+		size_t len = strlen(profiles[i].name);
+		if (len > best_len && strncmp(term, profiles[i].name, len) == 0)
+		{
+			best = &profiles[i];
+			best_len = len;
+		}
+	}
+	return best;
+}
+
+/**
+ * This function picks the output profile of the terminal the process is
+ * running in from TERM, and the color depth from TERM and COLORTERM.
+ * A "-256color" or "-direct" TERM or a truecolor COLORTERM raises the
+ * color depth of the profile.
+ *
+ * @param color_depth set to the COLOR_DEPTH_* of the terminal
+ * @return the profile, never NULL
+ */
+const term_profile_t *terminalDetect(int *color_depth)
+{
+	const char *term = getenv("TERM");
+	const char *colorterm = getenv("COLORTERM");
+	const term_profile_t *profile = terminalProfile(term);
+	int depth = profile->color_depth;
+
+	if (term != NULL && strstr(term, "256color") != NULL && depth < COLOR_DEPTH_256)
+		depth = COLOR_DEPTH_256;
+	if (term != NULL && strstr(term, "direct") != NULL)
+		depth = COLOR_DEPTH_TRUE;
+	if (colorterm != NULL && depth != COLOR_DEPTH_MONO
+		&& (strcmp(colorterm, "truecolor") == 0 || strcmp(colorterm, "24bit") == 0))
+		depth = COLOR_DEPTH_TRUE;
+
+	*color_depth = depth;
+	return profile;
+}
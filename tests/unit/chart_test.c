@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <display.h>
+#include "check.h"
+
+/**
+ * The chart test checks how series are scaled to their own range and how
+ * a heatmap grid is shrunk into a smaller box.
+ */
+
+static void checkSparkline(window_t *window, int count, int low, int high)
+{
+	float values[40];
+	int i;
+	for (i = 0; i < count; i++)
+		values[i] = 50 + i % 3;
+	values[low] = -7;
+	values[high] = 93;
+	windowSparkline(window, values, count, 0, 0, WHITE, 0, 0, count);
+	CHECK_MSG(window->contents[0][low] == '_' && window->contents[0][high] == '@',
+			"%d values, lowest at %d, highest at %d", count, low, high);
+	for (i = 0; i < count; i++)
+	{
+		if (i != low && i != high)
+			CHECK(window->contents[0][i] == '+');
+	}
+}
+
+int main(int argc, char** argv)
+{
+	FILE *term = fopen("/dev/null", "w");
+	display_t *display = newDisplay(term, 12, 40);
+	window_t *window = newWindow(display, 0, 0, 0, 12, 40);
+
+	// the range is found in every lane and in the values after the last
+	// whole group of lanes
+	checkSparkline(window, 2, 0, 1);
+	checkSparkline(window, 21, 19, 20);
+	checkSparkline(window, 21, 3, 12);
+	checkSparkline(window, 32, 31, 7);
+	checkSparkline(window, 40, 0, 39);
+
+	// a grid with more rows than the box: each box row is the mean of the
+	// grid rows on it
+	static const float grid[8] = {
+		0, 10,
+		10, 0,
+		0, 0,
+		10, 10
+	};
+	static const color_value_t ramp[3] = {COLOR_RGB(0, 0, 0), COLOR_RGB(0, 0, 128),
+				COLOR_RGB(0, 0, 255)};
+	background_t slots[3];
+	int k;
+	for (k = 0; k < 3; k++)
+		slots[k] = windowPaletteSlot(window, ramp[k]);
+	windowHeatmap(window, grid, 4, 2, 0, 0, ramp, 3, 2, 0, 2, 2);
+	CHECK(window->backgrounds[2][0] == slots[1] && window->backgrounds[2][1] == slots[1]);
+	CHECK(window->backgrounds[3][0] == slots[1] && window->backgrounds[3][1] == slots[1]);
+
+	// and columns are averaged the same way
+	windowHeatmap(window, grid, 4, 2, 0, 10, ramp, 3, 5, 0, 4, 1);
+	CHECK(window->backgrounds[5][0] == slots[1] && window->backgrounds[6][0] == slots[1]);
+	CHECK(window->backgrounds[7][0] == slots[0] && window->backgrounds[8][0] == slots[2]);
+
+	// a grid with fewer rows than the box leaves the rest of the box alone
+	windowFill(window, FILL_GLYPH, '#', 0, 0, 9, 0, 3, 2);
+	windowHeatmap(window, grid, 1, 2, 0, 10, ramp, 3, 9, 0, 3, 2);
+	CHECK(window->backgrounds[9][0] == slots[0] && window->backgrounds[9][1] == slots[2]);
+	CHECK(window->contents[9][0] == ' ' && window->contents[10][0] == '#');
+
+	freeWindow(window);
+	freeDisplay(display);
+	fclose(term);
+	return checkResult();
+}
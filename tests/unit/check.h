@@ -0,0 +1,43 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+/**
+ * check.h holds what the unit tests share. Each test is its own program
+ * run by ctest; a failed CHECK prints where it failed and the program
+ * exits non zero through checkResult.
+ */
+
+static int check_failures = 0;
+
+#define CHECK(cond) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			check_failures++; \
+		} \
+	} while (0)
+
+#define CHECK_MSG(cond, ...) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			fprintf(stderr, "%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+			fprintf(stderr, __VA_ARGS__); \
+			fputc('\n', stderr); \
+			check_failures++; \
+		} \
+	} while (0)
+
+static int checkResult(void)
+{
+	if (check_failures > 0)
+		fprintf(stderr, "%d checks failed\n", check_failures);
+	return check_failures > 0;
+}
+
+#endif
@@ -0,0 +1,482 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <display.h>
+#include "check.h"
+
+/**
+ * The encoder test draws frames on a display and plays what it sends into
+ * a model terminal. After each frame the model screen must show exactly
+ * the cells the display believes the terminal shows. The model follows
+ * the profile it is given: erases only use the current background on BCE
+ * terminals, and anything it does not know counts as an error.
+ */
+
+#define ROWS 12
+#define COLS 40
+
+struct model_cell_struct
+{
+	char data;
+	int attr;
+	color_value_t color;
+	color_value_t background;
+};
+typedef struct model_cell_struct model_cell_t;
+
+struct model_struct
+{
+	const term_profile_t *profile;
+	model_cell_t cells[ROWS][COLS];
+	int x;
+	int y;
+	char wrap; // the last column was written, the next glyph would wrap
+	model_cell_t style;
+	int saved_x;
+	int saved_y;
+	model_cell_t saved_style;
+	int top;
+	int bottom;
+	char last;
+	int state;
+	int params[16];
+	int param_count;
+	char priv;
+	unsigned long finals[128]; // CSI sequences seen, by final byte
+	unsigned long index_count;
+	unsigned long reverse_index_count;
+	unsigned long color_count;
+	int errors;
+};
+typedef struct model_struct model_t;
+
+enum model_state_enum
+{
+	M_GROUND,
+	M_ESCAPE,
+	M_CSI
+};
+
+static void modelBlank(model_t *model, model_cell_t *cell)
+{
+	cell->data = ' ';
+	cell->attr = 0;
+	cell->color = COLOR_NONE;
+	cell->background = COLOR_NONE;
+	if (model->profile->caps & CAP_BCE)
+	{
+		cell->color = model->style.color;
+		cell->background = model->style.background;
+	}
+}
+
+static void modelInit(model_t *model, const term_profile_t *profile)
+{
+	memset(model, 0, sizeof(model_t));
+	model->profile = profile;
+	model->style.color = COLOR_NONE;
+	model->style.background = COLOR_NONE;
+	model->saved_style = model->style;
+	model->bottom = ROWS;
+	int i, j;
+	for (i = 0; i < ROWS; i++)
+		for (j = 0; j < COLS; j++)
+			modelBlank(model, &model->cells[i][j]);
+}
+
+static void modelPut(model_t *model, char c)
+{
+	if (model->wrap)
+	{
+		// the encoder never relies on autowrap
+		model->errors++;
+		model->wrap = 0;
+		model->y = 0;
+		if (model->x < ROWS - 1)
+			model->x++;
+	}
+	model_cell_t *cell = &model->cells[model->x][model->y];
+	*cell = model->style;
+	cell->data = c;
+	model->last = c;
+	if (model->y == COLS - 1)
+		model->wrap = 1;
+	else
+		model->y++;
+}
+
+static void modelScroll(model_t *model, int up)
+{
+	int height = model->bottom - model->top;
+	size_t row = sizeof(model->cells[0]);
+	int j;
+	if (up)
+	{
+		memmove(model->cells[model->top], model->cells[model->top + 1], row * (height - 1));
+		for (j = 0; j < COLS; j++)
+			modelBlank(model, &model->cells[model->bottom - 1][j]);
+	}
+	else
+	{
+		memmove(model->cells[model->top + 1], model->cells[model->top], row * (height - 1));
+		for (j = 0; j < COLS; j++)
+			modelBlank(model, &model->cells[model->top][j]);
+	}
+}
+
+static void modelSgr(model_t *model)
+{
+	static const int attrs[8] = {0, ATTR_BOLD, ATTR_DIM, ATTR_ITALIC,
+				ATTR_UNDERLINE, ATTR_BLINK, 0, ATTR_REVERSE};
+	int *p = model->params;
+	int n = model->param_count == 0 ? 1 : model->param_count;
+	int i;
+	for (i = 0; i < n; i++)
+	{
+		color_value_t *target = p[i] < 40 || (p[i] >= 90 && p[i] < 100)
+				? &model->style.color : &model->style.background;
+		if (p[i] == 0)
+		{
+			model->style.attr = 0;
+			model->style.color = COLOR_NONE;
+			model->style.background = COLOR_NONE;
+		}
+		else if (p[i] < 8 && attrs[p[i]] != 0)
+		{
+			model->style.attr |= attrs[p[i]];
+		}
+		else if ((p[i] >= 30 && p[i] <= 37) || (p[i] >= 40 && p[i] <= 47))
+		{
+			*target = p[i] % 10;
+			model->color_count++;
+		}
+		else if ((p[i] >= 90 && p[i] <= 97) || (p[i] >= 100 && p[i] <= 107))
+		{
+			*target = p[i] % 10 + 8;
+			model->color_count++;
+		}
+		else if ((p[i] == 38 || p[i] == 48) && i + 2 < n && p[i + 1] == 5)
+		{
+			*target = p[i + 2];
+			model->color_count++;
+			i += 2;
+		}
+		else if ((p[i] == 38 || p[i] == 48) && i + 4 < n && p[i + 1] == 2)
+		{
+			*target = COLOR_RGB(p[i + 2], p[i + 3], p[i + 4]);
+			model->color_count++;
+			i += 4;
+		}
+		else
+		{
+			model->errors++;
+		}
+	}
+}
+
+static void modelCsi(model_t *model, char final)
+{
+	int *p = model->params;
+	int n = model->param_count;
+	int count = n > 0 && p[0] > 0 ? p[0] : 1;
+	int j;
+	model->finals[(unsigned char)final]++;
+	if (model->priv)
+	{
+		if (final != 'h' && final != 'l')
+			model->errors++;
+		return;
+	}
+	if (final != 'm')
+		model->wrap = 0;
+	switch (final)
+	{
+		case 'H':
+			model->x = n > 0 && p[0] > 0 ? p[0] - 1 : 0;
+			model->y = n > 1 && p[1] > 0 ? p[1] - 1 : 0;
+			if (model->x >= ROWS) model->x = ROWS - 1;
+			if (model->y >= COLS) model->y = COLS - 1;
+			break;
+		case 'C':
+			model->y += count;
+			if (model->y >= COLS) model->y = COLS - 1;
+			break;
+		case 'K':
+			if (n > 0 && p[0] != 0)
+				model->errors++;
+			for (j = model->y; j < COLS; j++)
+				modelBlank(model, &model->cells[model->x][j]);
+			break;
+		case 'X':
+			for (j = model->y; j < model->y + count && j < COLS; j++)
+				modelBlank(model, &model->cells[model->x][j]);
+			break;
+		case 'b':
+			for (j = 0; j < count; j++)
+				modelPut(model, model->last);
+			break;
+		case 'J':
+			if (n == 0 || p[0] != 2)
+				model->errors++;
+			modelInit(model, model->profile);
+			break;
+		case 'r':
+			model->top = n > 0 && p[0] > 0 ? p[0] - 1 : 0;
+			model->bottom = n > 1 && p[1] > 0 ? p[1] : ROWS;
+			model->x = 0;
+			model->y = 0;
+			break;
+		case 'm':
+			modelSgr(model);
+			break;
+		default:
+			model->errors++;
+	}
+}
+
+static void modelFeed(model_t *model, const char *data, size_t length)
+{
+	size_t i;
+	for (i = 0; i < length; i++)
+	{
+		char c = data[i];
+		switch (model->state)
+		{
+			case M_GROUND:
+				if (c == '\033')
+					model->state = M_ESCAPE;
+				else if (c >= ' ' && c < 0x7f)
+					modelPut(model, c);
+				else
+					model->errors++;
+				break;
+			case M_ESCAPE:
+				model->state = M_GROUND;
+				if (c == '[')
+				{
+					model->state = M_CSI;
+					model->param_count = 0;
+					model->priv = 0;
+					memset(model->params, 0, sizeof(model->params));
+				}
+				else if (c == '7')
+				{
+					model->saved_x = model->x;
+					model->saved_y = model->y;
+					model->saved_style = model->style;
+				}
+				else if (c == '8')
+				{
+					model->x = model->saved_x;
+					model->y = model->saved_y;
+					model->style = model->saved_style;
+					model->wrap = 0;
+				}
+				else if (c == 'D')
+				{
+					model->index_count++;
+					model->wrap = 0;
+					if (model->x == model->bottom - 1)
+						modelScroll(model, 1);
+					else if (model->x < ROWS - 1)
+						model->x++;
+				}
+				else if (c == 'M')
+				{
+					model->reverse_index_count++;
+					model->wrap = 0;
+					if (model->x == model->top)
+						modelScroll(model, 0);
+					else if (model->x > 0)
+						model->x--;
+				}
+				else
+				{
+					model->errors++;
+				}
+				break;
+			case M_CSI:
+				if (c == '?')
+				{
+					model->priv = 1;
+				}
+				else if (c >= '0' && c <= '9')
+				{
+					if (model->param_count == 0)
+						model->param_count = 1;
+					int *param = &model->params[model->param_count - 1];
+					*param = *param * 10 + (c - '0');
+				}
+				else if (c == ';')
+				{
+					if (model->param_count == 0)
+						model->param_count = 1;
+					if (model->param_count < 16)
+						model->param_count++;
+				}
+				else
+				{
+					model->state = M_GROUND;
+					modelCsi(model, c);
+				}
+				break;
+		}
+	}
+}
+
+static color_value_t cellColor(const unsigned char *bytes, int rgb, int depth)
+{
+	if (rgb)
+		return COLOR_RGB(bytes[0], bytes[1], bytes[2]);
+	return depth == COLOR_DEPTH_16 ? bytes[2] & 0xf : bytes[2];
+}
+
+/**
+ * This function checks that the model screen shows what the display
+ * believes the terminal shows.
+ */
+static void compareScreen(model_t *model, display_t *display, const char *step)
+{
+	int depth = display->color_depth;
+	int planes = displayDrawnPlanes(display);
+	int i, j;
+	for (i = 0; i < ROWS; i++)
+	{
+		for (j = 0; j < COLS; j++)
+		{
+			const cell_t *want = &display->current[i][j];
+			const model_cell_t *got = &model->cells[i][j];
+			int same = got->data == want->data && got->attr == (want->attr & ATTR_ALL);
+			// only the planes the display draws have colors to compare
+			if (planes & FILL_COLOR)
+				same = same
+					&& got->color == cellColor(want->color, want->attr & CELL_COLOR_RGB, depth);
+			if (planes & FILL_BACKGROUND)
+				same = same
+					&& got->background == cellColor(want->background,
+								want->attr & CELL_BACKGROUND_RGB, depth);
+			CHECK_MSG(same, "%s %s: cell %d,%d is '%c' %x/%x, expected '%c'",
+					model->profile->name, step, i, j, got->data,
+					got->color, got->background, want->data);
+			if (!same)
+				return;
+		}
+	}
+}
+
+struct capture_struct
+{
+	FILE *term;
+	char *data;
+	size_t length;
+	size_t seen;
+};
+typedef struct capture_struct capture_t;
+
+static void feedNew(capture_t *capture, model_t *model)
+{
+	fflush(capture->term);
+	modelFeed(model, capture->data + capture->seen, capture->length - capture->seen);
+	capture->seen = capture->length;
+}
+
+static void frame(capture_t *capture, model_t *model, display_t *display, const char *step)
+{
+	displayUpdate(display);
+	feedNew(capture, model);
+	CHECK_MSG(model->errors == 0, "%s %s: %d unexpected sequences",
+			model->profile->name, step, model->errors);
+	model->errors = 0;
+	compareScreen(model, display, step);
+}
+
+static void runProfile(const char *name)
+{
+	capture_t capture = {NULL, NULL, 0, 0};
+	capture.term = open_memstream(&capture.data, &capture.length);
+	const term_profile_t *profile = terminalProfile(name);
+	model_t model;
+	modelInit(&model, profile);
+
+	display_t *display = newDisplay(capture.term, ROWS, COLS);
+	displaySetProfile(display, profile);
+	feedNew(&capture, &model);
+
+	// a text frame with a few colors and attributes
+	window_t *back = newWindow(display, 0, 0, 0, ROWS, COLS);
+	windowSetColorValue(back, COLOR_RGB(200, 200, 200));
+	windowSetBackgroundValue(back, COLOR_RGB(0, 0, 96));
+	int i;
+	for (i = 0; i < ROWS; i++)
+		windowPrint(back, "the quick brown fox jumps over the lazy dog", i, 0);
+	windowPrintValue(back, "rgb", COLOR_RGB(250, 80, 10), COLOR_RGB(10, 80, 250), 1, 4);
+	windowPrintColor(back, "red", RED, 2, 8);
+	windowPrintBackground(back, "cyan", BLACK, BRIGHT_CYAN, 3, 12);
+	windowPrintAttr(back, "bold", ATTR_BOLD | ATTR_UNDERLINE, 4, 2);
+	frame(&capture, &model, display, "text");
+
+	// a blank to the end of a line, a blank in the middle of one
+	windowFill(back, FILL_GLYPH, ' ', 0, 0, 5, 4, 1, COLS);
+	windowFill(back, FILL_GLYPH, ' ', 0, 0, 6, 8, 1, 20);
+	frame(&capture, &model, display, "erase");
+
+	// a run of one glyph and a few scattered changes on one row
+	windowFill(back, FILL_GLYPH, '=', 0, 0, 7, 2, 1, 30);
+	windowChar(back, '#', 8, 1);
+	windowChar(back, '#', 8, 9);
+	windowChar(back, '#', 8, 20);
+	frame(&capture, &model, display, "repeat");
+
+	// an attribute dropped mid frame needs a reset
+	windowPrintAttr(back, "bold", 0, 4, 2);
+	frame(&capture, &model, display, "reset");
+
+	// a bordered window over the text, then removed again
+	window_t *top = newWindow(display, 1, 2, 5, 6, 20);
+	windowSetBoarder(top, WHITE, BLUE, '|', '-', '+');
+	windowPrint(top, "on top", 0, 0);
+	frame(&capture, &model, display, "window");
+	freeWindow(top);
+	frame(&capture, &model, display, "unwindow");
+
+	// a pad scrolled both ways
+	window_t *pad = newPad(display, 0, 2, 0, 8, COLS, 100, COLS);
+	char line[COLS];
+	for (i = 0; i < 100; i++)
+	{
+		snprintf(line, sizeof(line), "pad line %d of the canvas", i);
+		padPrint(pad, line, i, i % 7);
+	}
+	frame(&capture, &model, display, "pad");
+	padScroll(pad, 3);
+	frame(&capture, &model, display, "scroll down");
+	padScroll(pad, -2);
+	frame(&capture, &model, display, "scroll up");
+	padScroll(pad, 1);
+	windowPrint(back, "under", 0, 0);
+	frame(&capture, &model, display, "scroll and draw");
+
+	int caps = profile->caps;
+	CHECK_MSG(model.finals['C'] > 0, "%s: no CUF", name);
+	CHECK_MSG((model.finals['r'] > 0) == !!(caps & CAP_SCROLL_REGION), "%s: DECSTBM", name);
+	CHECK_MSG(model.index_count > 0 && model.reverse_index_count > 0, "%s: no IND/RI", name);
+	CHECK_MSG((model.finals['K'] > 0) == !!((caps & CAP_EL) && (caps & CAP_BCE)), "%s: EL", name);
+	CHECK_MSG((model.finals['X'] > 0) == !!((caps & CAP_ECH) && (caps & CAP_BCE)), "%s: ECH", name);
+	CHECK_MSG((model.finals['b'] > 0) == !!(caps & CAP_REP), "%s: REP", name);
+	CHECK_MSG((model.color_count > 0) == (displayDrawnPlanes(display) != 0),
+			"%s: color", name);
+
+	freeWindow(pad);
+	freeWindow(back);
+	freeDisplay(display);
+	fclose(capture.term);
+	free(capture.data);
+}
+
+int main(int argc, char** argv)
+{
+	runProfile("linux");
+	runProfile("xterm-kitty");
+	runProfile("vt100");
+	return checkResult();
+}
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <display.h>
+#include "check.h"
+
+/**
+ * The input test runs a table of terminal input through the decoder.
+ * Each entry is fed whole, a byte at a time and split in two at every
+ * point, and must decode to the same events every way.
+ */
+
+#define MAX_EVENTS 16
+
+struct expect_struct
+{
+	int type;
+	int key;
+	int modifiers;
+	int action;
+	int x;
+	int y;
+	const char *text;
+};
+typedef struct expect_struct expect_t;
+
+struct case_struct
+{
+	const char *name;
+	const char *data;
+	expect_t events[MAX_EVENTS];
+	int count;
+};
+typedef struct case_struct case_t;
+
+#define KEY(k, mods) {INPUT_KEY, (k), (mods), 0, 0, 0, NULL}
+#define MOUSE(k, mods, action, x, y) {INPUT_MOUSE, (k), (mods), (action), (x), (y), NULL}
+#define PASTE(text) {INPUT_PASTE, 0, 0, 0, 0, 0, (text)}
+
+static const case_t cases[] = {
+	{"text", "ab1", {KEY('a', 0), KEY('b', 0), KEY('1', 0)}, 3},
+	{"utf8", "\xc3\xa9\xe2\x82\xac", {KEY(0xe9, 0), KEY(0x20ac, 0)}, 2},
+	{"control", "\r\t\x7f", {KEY(KEY_ENTER, 0), KEY(KEY_TAB, 0), KEY(KEY_BACKSPACE, 0)}, 3},
+	{"alt", "\033x", {KEY('x', MOD_ALT)}, 1},
+	{"arrows", "\033[A\033[B\033OC\033[1;5D",
+		{KEY(KEY_UP, 0), KEY(KEY_DOWN, 0), KEY(KEY_RIGHT, 0), KEY(KEY_LEFT, MOD_CTRL)}, 4},
+	{"tilde", "\033[3~\033[5;2~\033[24~",
+		{KEY(KEY_DELETE, 0), KEY(KEY_PAGE_UP, MOD_SHIFT), KEY(KEY_F12, 0)}, 3},
+	{"linux console f-keys", "\033[[A\033[[B\033[[C\033[[D\033[[E\033[[Fz",
+		{KEY(KEY_F1, 0), KEY(KEY_F2, 0), KEY(KEY_F3, 0), KEY(KEY_F4, 0), KEY(KEY_F5, 0),
+		KEY('z', 0)}, 6},
+	{"backtab", "\033[Z", {KEY(KEY_BACKTAB, MOD_SHIFT)}, 1},
+	{"escape then key", "\033\033[A", {KEY(KEY_ESCAPE, 0), KEY(KEY_UP, 0)}, 2},
+	{"unknown sequence", "\033[99qz", {KEY('z', 0)}, 1},
+	{"mouse press", "\033[<0;5;3M", {MOUSE(MOUSE_LEFT, 0, MOUSE_PRESS, 2, 4)}, 1},
+	{"mouse release", "\033[<2;1;1m", {MOUSE(MOUSE_RIGHT, 0, MOUSE_RELEASE, 0, 0)}, 1},
+	{"mouse drag", "\033[<32;10;4M", {MOUSE(MOUSE_LEFT, 0, MOUSE_MOVE, 3, 9)}, 1},
+	{"mouse move", "\033[<35;2;2M", {MOUSE(MOUSE_NONE, 0, MOUSE_MOVE, 1, 1)}, 1},
+	{"mouse wheel", "\033[<64;7;7M\033[<65;7;7M",
+		{MOUSE(MOUSE_WHEEL_UP, 0, MOUSE_PRESS, 6, 6),
+		MOUSE(MOUSE_WHEEL_DOWN, 0, MOUSE_PRESS, 6, 6)}, 2},
+	{"mouse modifiers", "\033[<20;3;3M", {MOUSE(MOUSE_LEFT, MOD_SHIFT | MOD_CTRL, MOUSE_PRESS, 2, 2)}, 1},
+	{"mouse short", "\033[<0;5Mk", {KEY('k', 0)}, 1},
+	{"paste", "\033[200~hello\033[201~", {PASTE("hello")}, 1},
+	{"paste with escape", "\033[200~a\033b\033[20x\033[201\033[201~!",
+		{PASTE("a\033b\033[20x\033[201"), KEY('!', 0)}, 2},
+	{"paste of a sequence", "\033[200~\033[A\033[201~", {PASTE("\033[A")}, 1},
+	{"empty paste", "\033[200~\033[201~q", {PASTE(""), KEY('q', 0)}, 2},
+	{"parameter overflow", "\033[99999999999999999999999999A\033[3;99999999999999~x",
+		{KEY(KEY_UP, 0), KEY(KEY_DELETE, 99998), KEY('x', 0)}, 3},
+	{"too many parameters", "\033[1;2;3;4;5;6;7;8;9;10;11;12;13;14~y",
+		{KEY(KEY_HOME, MOD_SHIFT), KEY('y', 0)}, 2},
+	{"mouse coordinate overflow", "\033[<0;999999999999;2M",
+		{MOUSE(MOUSE_LEFT, 0, MOUSE_PRESS, 1, 99998)}, 1},
+};
+
+#define CASE_COUNT (int)(sizeof(cases) / sizeof(cases[0]))
+
+struct result_struct
+{
+	input_event_t events[MAX_EVENTS];
+	char text[MAX_EVENTS][64];
+	int count;
+};
+typedef struct result_struct result_t;
+
+static void feed(input_t *input, result_t *result, const char *data, size_t length)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	while (length > 0)
+	{
+		input_event_t events[MAX_EVENTS];
+		size_t used;
+		int made = inputParse(input, bytes, length, events, MAX_EVENTS, &used);
+		int i;
+		for (i = 0; i < made && result->count < MAX_EVENTS; i++)
+		{
+			input_event_t *event = &result->events[result->count];
+			*event = events[i];
+			if (event->type == INPUT_PASTE)
+			{
+				// copy the text, it is only good until the next call
+				size_t n = event->length < 63 ? event->length : 63;
+				memcpy(result->text[result->count], event->text, n);
+				result->text[result->count][n] = '\0';
+				event->text = result->text[result->count];
+			}
+			result->count++;
+		}
+		bytes += used;
+		length -= used;
+		if (used == 0 && made == 0)
+			break;
+	}
+}
+
+static void checkCase(const case_t *test, const result_t *result, const char *how)
+{
+	CHECK_MSG(result->count == test->count, "%s (%s): %d events, expected %d",
+			test->name, how, result->count, test->count);
+	int i;
+	for (i = 0; i < result->count && i < test->count; i++)
+	{
+		const input_event_t *got = &result->events[i];
+		const expect_t *want = &test->events[i];
+		CHECK_MSG(got->type == want->type, "%s (%s): event %d type %d",
+				test->name, how, i, got->type);
+		if (got->type != want->type)
+			continue;
+		if (want->type == INPUT_PASTE)
+		{
+			CHECK_MSG(got->key == 0 && strcmp(got->text, want->text) == 0,
+					"%s (%s): paste \"%s\"", test->name, how, got->text);
+			continue;
+		}
+		CHECK_MSG(got->key == want->key && got->modifiers == want->modifiers,
+				"%s (%s): event %d key %x mods %d", test->name, how, i, got->key, got->modifiers);
+		if (want->type == INPUT_MOUSE)
+			CHECK_MSG(got->action == want->action && got->pos.x == want->x
+					&& got->pos.y == want->y, "%s (%s): mouse %d at %d,%d",
+					test->name, how, got->action, got->pos.x, got->pos.y);
+	}
+}
+
+static void runCases(display_t *display, int fd)
+{
+	int c;
+	for (c = 0; c < CASE_COUNT; c++)
+	{
+		const case_t *test = &cases[c];
+		size_t length = strlen(test->data);
+		result_t result;
+		char how[32];
+
+		input_t *input = newInput(display, fd);
+		memset(&result, 0, sizeof(result));
+		feed(input, &result, test->data, length);
+		checkCase(test, &result, "whole");
+		freeInput(input);
+
+		input = newInput(display, fd);
+		memset(&result, 0, sizeof(result));
+		size_t i;
+		for (i = 0; i < length; i++)
+			feed(input, &result, test->data + i, 1);
+		checkCase(test, &result, "bytes");
+		freeInput(input);
+
+		for (i = 1; i < length; i++)
+		{
+			input = newInput(display, fd);
+			memset(&result, 0, sizeof(result));
+			feed(input, &result, test->data, i);
+			feed(input, &result, test->data + i, length - i);
+			snprintf(how, sizeof(how), "split at %zu", i);
+			checkCase(test, &result, how);
+			freeInput(input);
+		}
+	}
+}
+
+/**
+ * Mouse reports name the topmost window under the pointer, skipping
+ * hidden windows and cells a window shows through.
+ */
+static void checkWindowAt(display_t *display, int fd)
+{
+	window_t *back = newWindow(display, 0, 0, 0, 10, 40);
+	window_t *over = newWindow(display, 1, 2, 10, 5, 20);
+	window_t *pad = newPad(display, 0, 8, 0, 2, 10, 100, 10);
+	windowPrint(over, "hi", 0, 0);
+	padPrint(pad, "pad", 0, 0);
+	padPrint(pad, "x", 2, 0);
+
+	CHECK(displayWindowAt(display, 0, 0) == back);
+	CHECK(displayWindowAt(display, 1, 9) == over);
+	CHECK(displayWindowAt(display, 2, 10) == over);
+	CHECK(displayWindowAt(display, 2, 15) == over);
+	CHECK(displayWindowAt(display, 8, 1) == pad);
+	CHECK(displayWindowAt(display, 9, 1) == pad);
+	CHECK(displayWindowAt(display, 20, 1) == NULL);
+
+	windowSetTransparency(over, TRANSPARENT_UNWRITTEN);
+	windowSetTransparency(pad, TRANSPARENT_UNWRITTEN);
+	CHECK(displayWindowAt(display, 1, 9) == over);
+	CHECK(displayWindowAt(display, 2, 10) == over);
+	CHECK(displayWindowAt(display, 2, 15) == back);
+	CHECK(displayWindowAt(display, 8, 1) == pad);
+	CHECK(displayWindowAt(display, 8, 5) == back);
+	CHECK(displayWindowAt(display, 9, 1) == back);
+	padScroll(pad, 1);
+	CHECK(displayWindowAt(display, 8, 1) == back);
+	CHECK(displayWindowAt(display, 9, 0) == pad);
+	CHECK(displayWindowAt(display, 9, 1) == back);
+
+	windowSetTransparency(over, TRANSPARENT_MASK);
+	windowSetMask(over, 1, 0, 0, 5, 20);
+	CHECK(displayWindowAt(display, 1, 9) == over);
+	CHECK(displayWindowAt(display, 2, 10) == back);
+	windowSetMask(over, 0, 0, 0, 1, 1);
+	CHECK(displayWindowAt(display, 2, 10) == over);
+	CHECK(displayWindowAt(display, 2, 11) == back);
+
+	windowSetHide(over, 1);
+	CHECK(displayWindowAt(display, 2, 10) == back);
+
+	input_t *input = newInput(display, fd);
+	result_t result;
+	memset(&result, 0, sizeof(result));
+	feed(input, &result, "\033[<0;11;3M", 10);
+	CHECK(result.count == 1 && result.events[0].window == back);
+	windowSetHide(over, 0);
+	feed(input, &result, "\033[<0;11;3M", 10);
+	CHECK(result.count == 2 && result.events[1].window == over
+		&& result.events[1].window_pos.x == 0 && result.events[1].window_pos.y == 0);
+	freeInput(input);
+
+	freeWindow(pad);
+	freeWindow(over);
+	freeWindow(back);
+}
+
+int main(int argc, char** argv)
+{
+	int fds[2];
+	CHECK(pipe(fds) == 0);
+	FILE *term = fopen("/dev/null", "w");
+	display_t *display = newDisplay(term, 24, 80);
+
+	runCases(display, fds[0]);
+	checkWindowAt(display, fds[0]);
+
+	freeDisplay(display);
+	fclose(term);
+	close(fds[0]);
+	close(fds[1]);
+	return checkResult();
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <display.h>
+#include "check.h"
+
+/**
+ * The layout test prints texts into boxes with windowPrintLayout and
+ * checks every row of the box, blanks included.
+ */
+
+static window_t *window;
+
+static void checkBox(const char *str, int flags, int cols, int lines,
+				const char *const *rows, int row_count)
+{
+	windowFill(window, FILL_GLYPH, '#', 0, 0, 0, 0, 10, 30);
+	int got = windowPrintLayout(window, str, flags, 1, 2, row_count, cols);
+	CHECK_MSG(got == lines, "\"%s\" at %d: %d lines, expected %d", str, cols, got, lines);
+	CHECK_MSG(layoutLines(str, cols) == lines, "\"%s\" at %d: layoutLines", str, cols);
+	char row[32];
+	int i;
+	for (i = 0; i < row_count; i++)
+	{
+		memcpy(row, window->contents[i + 1] + 2, cols);
+		row[cols] = '\0';
+		CHECK_MSG(strcmp(row, rows[i]) == 0, "\"%s\" at %d, flags %d: row %d is \"%s\", expected \"%s\"",
+				str, cols, flags, i, row, rows[i]);
+	}
+	// nothing outside the box is written
+	CHECK(window->contents[0][2] == '#' && window->contents[1][1] == '#');
+	CHECK(window->contents[1][2 + cols] == '#' && window->contents[row_count + 1][2] == '#');
+}
+
+#define BOX(str, flags, cols, lines, ...) \
+	do \
+	{ \
+		static const char *const rows[] = {__VA_ARGS__}; \
+		checkBox((str), (flags), (cols), (lines), rows, sizeof(rows) / sizeof(rows[0])); \
+	} while (0)
+
+int main(int argc, char** argv)
+{
+	FILE *term = fopen("/dev/null", "w");
+	display_t *display = newDisplay(term, 12, 40);
+	window = newWindow(display, 0, 0, 0, 10, 30);
+
+	// word wrap, the spaces a line breaks at are dropped
+	BOX("the quick brown fox jumps", LAYOUT_LEFT, 10, 3,
+		"the quick ", "brown fox ", "jumps     ", "          ");
+	BOX("a  lot   of    space", LAYOUT_LEFT, 6, 3,
+		"a  lot", "of    ", "space ", "      ");
+	BOX("tab\tand\rreturn", LAYOUT_LEFT, 8, 2,
+		"tab and ", "return  ");
+
+	// words longer than a line are split
+	BOX("abcdefghijklmnop xy", LAYOUT_LEFT, 6, 4,
+		"abcdef", "ghijkl", "mnop  ", "xy    ");
+	BOX("abcdefgh", LAYOUT_LEFT, 4, 2,
+		"abcd", "efgh");
+
+	// new lines always break, and an empty line is a line
+	BOX("a\n\nb c", LAYOUT_LEFT, 5, 3,
+		"a    ", "     ", "b c  ");
+	BOX("", LAYOUT_LEFT, 5, 1,
+		"     ");
+
+	// alignment
+	BOX("ab cd", LAYOUT_LEFT, 7, 1, "ab cd  ");
+	BOX("ab cd", LAYOUT_CENTER, 7, 1, " ab cd ");
+	BOX("ab cd", LAYOUT_RIGHT, 7, 1, "  ab cd");
+	BOX("one two three", LAYOUT_RIGHT, 8, 2, " one two", "   three");
+	BOX("one two three", LAYOUT_CENTER, 8, 2, "one two ", " three  ");
+
+	// text that does not fit is cut, with an ellipsis if asked for
+	BOX("one two three four five", LAYOUT_LEFT, 12, 3, "one two     ");
+	BOX("one two three four five", LAYOUT_LEFT | LAYOUT_ELLIPSIS, 12, 3, "one two...  ");
+	BOX("one two three four five", LAYOUT_CENTER | LAYOUT_ELLIPSIS, 12, 3, " one two... ");
+	BOX("one two three four five", LAYOUT_RIGHT | LAYOUT_ELLIPSIS, 12, 3, "  one two...");
+	BOX("one two three four five", LAYOUT_CENTER | LAYOUT_ELLIPSIS, 11, 3,
+		"  one two  ", "three fo...");
+	BOX("abcdefghij", LAYOUT_RIGHT | LAYOUT_ELLIPSIS, 5, 2, "ab...");
+	BOX("abcdefghij", LAYOUT_LEFT | LAYOUT_ELLIPSIS, 2, 5, "..");
+	BOX("ab cd", LAYOUT_CENTER | LAYOUT_ELLIPSIS, 7, 1, " ab cd ");
+
+	// a text changed in place is laid out again, not taken from the cache
+	char text[] = "aaaa bbbb";
+	BOX(text, LAYOUT_LEFT, 5, 2, "aaaa ", "bbbb ");
+	text[4] = 'a';
+	text[5] = ' ';
+	BOX(text, LAYOUT_LEFT, 5, 2, "aaaaa", "bbb  ");
+
+	// a bordered window places the box inside the boarder
+	window_t *framed = newWindow(display, 1, 1, 1, 3, 8);
+	CHECK(windowPrintLayout(framed, "hi there", LAYOUT_RIGHT, 0, 0, 3, 8) == 1);
+	CHECK(memcmp(framed->contents[1] + 1, "hi there", 8) == 0);
+	CHECK(windowPrintLayout(framed, "hi there", LAYOUT_RIGHT, 1, 2, 5, 6) == 2);
+	CHECK(memcmp(framed->contents[2] + 3, "    hi", 6) == 0);
+	CHECK(memcmp(framed->contents[3] + 3, " there", 6) == 0);
+
+	freeWindow(framed);
+	freeWindow(window);
+	freeDisplay(display);
+	fclose(term);
+	return checkResult();
+}
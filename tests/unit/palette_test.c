@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <display.h>
+#include "check.h"
+
+/**
+ * The palette test runs more colors through one window than its palette
+ * has slots and checks the colors drawn are the ones asked for.
+ */
+
+static display_t *display;
+
+static color_value_t cellColor(const cell_t *cell, int rgb_flag, const unsigned char *bytes)
+{
+	if (cell->attr & rgb_flag)
+		return COLOR_RGB(bytes[0], bytes[1], bytes[2]);
+	return bytes[2];
+}
+
+/**
+ * This function checks the color and background a window cell holds and,
+ * for the planes the display draws, the ones composed for it.
+ */
+static void checkCell(window_t *window, int x, int y, color_value_t color, color_value_t background)
+{
+	int d = window->boarder ? 1 : 0;
+	color_value_t held = window->palette.entries[window->colors[x + d][y + d]];
+	color_value_t held_back = window->palette.entries[window->backgrounds[x + d][y + d]];
+	CHECK_MSG(held == color && held_back == background, "cell %d,%d holds %x on %x, expected %x on %x",
+			x, y, held, held_back, color, background);
+
+	displayUpdate(display);
+	const cell_t *cell = &display->current[window->pos.x + x + d][window->pos.y + y + d];
+	if (displayDrawnPlanes(display) & FILL_COLOR)
+		CHECK_MSG(cellColor(cell, CELL_COLOR_RGB, cell->color) == color,
+				"cell %d,%d drawn in %x, expected %x", x, y,
+				cellColor(cell, CELL_COLOR_RGB, cell->color), color);
+	if (displayDrawnPlanes(display) & FILL_BACKGROUND)
+		CHECK_MSG(cellColor(cell, CELL_BACKGROUND_RGB, cell->background) == background,
+				"cell %d,%d drawn on %x, expected %x", x, y,
+				cellColor(cell, CELL_BACKGROUND_RGB, cell->background), background);
+}
+
+int main(int argc, char** argv)
+{
+	FILE *term = fopen("/dev/null", "w");
+	display = newDisplay(term, 12, 40);
+	displaySetColorDepth(display, COLOR_DEPTH_TRUE);
+	window_t *window = newWindow(display, 1, 0, 0, 10, 38);
+	int i;
+
+	// printed and cleared, every color gives its slot back
+	for (i = 0; i < 300; i++)
+	{
+		windowPrintValue(window, "x", COLOR_RGB(i, 255 - i, i / 2), i % 256, 0, 0);
+		windowClear(window);
+	}
+	windowPrintValue(window, "x", COLOR_RGB(10, 200, 30), 77, 0, 0);
+	checkCell(window, 0, 0, COLOR_RGB(10, 200, 30), 77);
+
+	// overwritten in place, too
+	for (i = 0; i < 600; i++)
+		windowFill(window, FILL_COLOR | FILL_BACKGROUND, '\0', i % 256, 255 - i % 256, 1, 1, 1, 1);
+	checkCell(window, 1, 1, 599 % 256, 255 - 599 % 256);
+
+	// colors still on the screen keep their slots while others come and go
+	for (i = 0; i < 30; i++)
+		windowPrintValue(window, "k", COLOR_RGB(200, i, 0), COLOR_RGB(0, 0, i), 2, i);
+	for (i = 0; i < 500; i++)
+		windowPrintValue(window, "y", COLOR_RGB(i % 256, i / 256, 9), i % 256, 3, 0);
+	for (i = 0; i < 30; i++)
+		checkCell(window, 2, i, COLOR_RGB(200, i, 0), COLOR_RGB(0, 0, i));
+	checkCell(window, 3, 0, COLOR_RGB(499 % 256, 1, 9), 499 % 256);
+	checkCell(window, 0, 0, COLOR_RGB(10, 200, 30), 77);
+
+	// the slots a pad's canvas holds are kept too
+	window_t *pad = newPad(display, 0, 0, 0, 4, 10, 600, 10);
+	padFill(pad, FILL_BACKGROUND, '\0', 0, 17, 590, 0, 1, 10);
+	for (i = 0; i < 300; i++)
+	{
+		if (i % 256 != 17)
+			padFill(pad, FILL_COLOR, '\0', i % 256, 0, 0, 0, 1, 10);
+	}
+	CHECK(pad->palette.entries[pad->pad->chunks[590 / PAD_CHUNK_ROWS]
+			->backgrounds[(590 % PAD_CHUNK_ROWS) * 10]] == 17);
+	CHECK(pad->palette.entries[pad->pad->chunks[0]->colors[0]] == 299 % 256);
+
+	freeWindow(pad);
+	freeWindow(window);
+	freeDisplay(display);
+	fclose(term);
+	return checkResult();
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <display.h>
+#include "check.h"
+
+/**
+ * The recorder test records more frames than fit between two key frames,
+ * keeping a copy of every frame the display sent, then replays the
+ * recording front to back and seeks around in it. Every screen the replay
+ * shows must be one of the live frames, in order.
+ */
+
+#define ROWS 10
+#define COLS 40
+#define FRAMES 700
+
+static cell_t *frames[FRAMES];
+static uint64_t times[FRAMES];
+static int planes; // the planes the recorded display drew
+
+static int sameFrame(const replay_t *replay, int k)
+{
+	return replay->rows == ROWS && replay->cols == COLS
+		&& memcmp(replay->cells, frames[k], sizeof(cell_t) * ROWS * COLS) == 0;
+}
+
+static void recordFrames(const char *path, int depth)
+{
+	FILE *term = fopen("/dev/null", "w");
+	display_t *display = newDisplay(term, ROWS, COLS);
+	displaySetColorDepth(display, depth);
+	window_t *window = newWindow(display, 1, 0, 0, ROWS, COLS);
+	planes = displayDrawnPlanes(display);
+	CHECK(displayStartRecording(display, path) == 0);
+
+	char text[32];
+	int k;
+	for (k = 0; k < FRAMES; k++)
+	{
+		snprintf(text, sizeof(text), "frame %d", k);
+		windowPrintColor(window, text, k % 16, k % (ROWS - 2), k % (COLS - 12));
+		windowChar(window, 'a' + k % 26, (k * 7) % (ROWS - 2), (k * 13) % (COLS - 2));
+		displayUpdate(display);
+		frames[k] = (cell_t *)malloc(sizeof(cell_t) * ROWS * COLS);
+		memcpy(frames[k], display->current[0], sizeof(cell_t) * ROWS * COLS);
+		usleep(20);
+	}
+
+	displayStopRecording(display);
+	freeWindow(window);
+	freeDisplay(display);
+	fclose(term);
+}
+
+static void checkReplay(const char *path)
+{
+	replay_t *replay = openReplay(path);
+	CHECK(replay != NULL);
+	if (replay == NULL)
+		return;
+	CHECK(replay->planes == planes);
+	CHECK(replay->keys == (FRAMES + 299) / 300);
+
+	// front to back: each recorded frame is the next live frame, or the
+	// key frame written along with the last one. The first delta comes
+	// before any key frame and shows nothing.
+	int k = -1;
+	while (replayNext(replay))
+	{
+		if (replay->cells == NULL)
+			continue;
+		if (k + 1 < FRAMES && sameFrame(replay, k + 1))
+		{
+			k++;
+			times[k] = replay->time;
+			continue;
+		}
+		CHECK_MSG(k >= 0 && sameFrame(replay, k), "replay left the live frames after %d", k);
+		if (k < 0 || !sameFrame(replay, k))
+			break;
+	}
+	CHECK_MSG(k == FRAMES - 1, "replayed %d of %d frames", k + 1, FRAMES);
+
+	// seeking lands on the last frame sent by the time sought, on both
+	// sides of each key frame
+	static const int seeks[] = {0, 1, 150, 298, 299, 300, 301, 450, 599, 600, 601, FRAMES - 1,
+				299, 0, FRAMES - 1, 300};
+	size_t i;
+	for (i = 0; k == FRAMES - 1 && i < sizeof(seeks) / sizeof(seeks[0]); i++)
+	{
+		int want = seeks[i];
+		while (want + 1 < FRAMES && times[want + 1] == times[want])
+			want++;
+		CHECK(replaySeek(replay, times[seeks[i]]));
+		CHECK_MSG(sameFrame(replay, want), "seek to frame %d", seeks[i]);
+	}
+	freeReplay(replay);
+}
+
+/**
+ * A window made with newCellWindow, as the replay tool uses, shows cells
+ * as they were sent however many colors they hold.
+ */
+static void checkCellWindow(void)
+{
+	FILE *term = fopen("/dev/null", "w");
+	display_t *display = newDisplay(term, ROWS, COLS);
+	displaySetColorDepth(display, COLOR_DEPTH_TRUE);
+	window_t *window = newCellWindow(display, 0, 0, ROWS, COLS);
+	static cell_t cells[ROWS * COLS];
+	int k;
+	for (k = 0; k < ROWS * COLS; k++)
+	{
+		memset(&cells[k], 0, sizeof(cell_t));
+		cells[k].data = 'a' + k % 26;
+		cells[k].attr = CELL_COLOR_RGB | (k % 2 ? CELL_BACKGROUND_RGB : 0);
+		cells[k].color[0] = k % 256;
+		cells[k].color[1] = k / 256;
+		cells[k].background[1] = k % 2 ? k / 2 : 0;
+		cells[k].background[2] = k % 256;
+	}
+	for (k = 0; k < ROWS; k++)
+		windowPutCells(window, cells + k * COLS, COLS, k, 0);
+	displayUpdate(display);
+
+	int drawn = displayDrawnPlanes(display);
+	for (k = 0; k < ROWS * COLS; k++)
+	{
+		cell_t want = cells[k];
+		if (!(drawn & FILL_COLOR))
+		{
+			memset(want.color, 0, 3);
+			want.attr &= ~CELL_COLOR_RGB;
+		}
+		if (!(drawn & FILL_BACKGROUND))
+		{
+			memset(want.background, 0, 3);
+			want.attr &= ~CELL_BACKGROUND_RGB;
+		}
+		CHECK_MSG(memcmp(&display->current[0][k], &want, sizeof(cell_t)) == 0,
+				"cell %d of the cell window", k);
+	}
+	CHECK(window->palette.count == PALETTE_BACKGROUND + 1);
+
+	freeWindow(window);
+	freeDisplay(display);
+	fclose(term);
+}
+
+int main(int argc, char** argv)
+{
+	char path[] = "/tmp/recordTestXXXXXX";
+	int fd = mkstemp(path);
+	CHECK(fd >= 0);
+	close(fd);
+
+	int k;
+	recordFrames(path, COLOR_DEPTH_256);
+	checkReplay(path);
+	for (k = 0; k < FRAMES; k++)
+		free(frames[k]);
+
+	// a monochrome display records no colors, and says so
+	recordFrames(path, COLOR_DEPTH_MONO);
+	CHECK(planes == 0);
+	checkReplay(path);
+	for (k = 0; k < FRAMES; k++)
+		free(frames[k]);
+
+	unlink(path);
+	checkCellWindow();
+	return checkResult();
+}
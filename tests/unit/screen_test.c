@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <display.h>
+#include "check.h"
+
+/**
+ * The screen set test checks that pages draw the way their set's terminal
+ * needs, and that hiding a page hands the terminal back.
+ */
+
+#define ROWS 6
+#define COLS 20
+
+static FILE *term;
+static char *data;
+static size_t length;
+static size_t seen;
+
+/**
+ * This function returns what was sent to the terminal since the last call.
+ */
+static const char *sent(void)
+{
+	static char copy[65536];
+	fflush(term);
+	size_t n = length - seen;
+	if (n >= sizeof(copy))
+		n = sizeof(copy) - 1;
+	memcpy(copy, data + seen, n);
+	copy[n] = '\0';
+	seen = length;
+	return copy;
+}
+
+static int knownBlank(screen_set_t *set)
+{
+	static const cell_t zero;
+	int i, j;
+	for (i = 0; i < set->dim.x; i++)
+		for (j = 0; j < set->dim.y; j++)
+			if (memcmp(&set->known[i][j], &zero, sizeof(cell_t)) != 0)
+				return 0;
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	setenv("TERM", "xterm-256color", 1);
+	unsetenv("COLORTERM");
+	term = open_memstream(&data, &length);
+	screen_set_t *set = newScreenSet(term, ROWS, COLS);
+	sent();
+	CHECK(set->color_depth == COLOR_DEPTH_256);
+
+	// pages take the set's profile and color depth
+	display_t *first = screenSetAddPage(set);
+	display_t *second = screenSetAddPage(set);
+	CHECK(first->profile == set->profile && second->profile == set->profile);
+	CHECK(first->color_depth == COLOR_DEPTH_256 && second->color_depth == COLOR_DEPTH_256);
+	window_t *one = newWindow(first, 0, 0, 0, ROWS, COLS);
+	window_t *two = newWindow(second, 0, 0, 0, ROWS, COLS);
+	windowPrintValue(one, "first", 130, 17, 0, 0);
+	windowPrintValue(two, "second", 130, 17, 0, 0);
+	displayUpdate(first);
+	displayUpdate(second);
+	const char *out = sent();
+	CHECK(strstr(out, "first") != NULL);
+	// the color only goes out in builds with a kernel that draws it
+	CHECK((strstr(out, "38;5;130") != NULL) == !!(displayDrawnPlanes(first) & FILL_COLOR));
+
+	// hiding a page that is not shown changes nothing
+	displaySetHide(second, 1);
+	CHECK(set->active == first && strlen(sent()) == 0);
+
+	// hiding the page shown hands the terminal back
+	displaySetHide(first, 1);
+	out = sent();
+	CHECK(set->active == NULL);
+	CHECK(strstr(out, "\033[7;1H") != NULL);
+	CHECK(strstr(out, set->profile->cursor_show) != NULL);
+	CHECK(knownBlank(set));
+
+	// nothing is drawn while hidden
+	windowPrint(one, "changed", 1, 0);
+	displayUpdate(first);
+	displayUpdate(second);
+	CHECK(strlen(sent()) == 0);
+
+	// showing a page again draws it whole and hides the cursor
+	displaySetHide(second, 0);
+	out = sent();
+	CHECK(set->active == second);
+	CHECK(strstr(out, set->profile->cursor_hide) != NULL);
+	CHECK(strstr(out, "second") != NULL);
+	CHECK(!knownBlank(set));
+	CHECK(memcmp(set->known[0], second->current[0], sizeof(cell_t) * ROWS * COLS) == 0);
+
+	// switching pages only sends what differs
+	displaySetHide(first, 0);
+	out = sent();
+	CHECK(set->active == first);
+	CHECK(strstr(out, set->profile->cursor_hide) == NULL);
+	CHECK(strstr(out, "changed") != NULL);
+	CHECK(memcmp(set->known[0], first->current[0], sizeof(cell_t) * ROWS * COLS) == 0);
+
+	// a page added while the set is hidden is not shown until asked for
+	displaySetHide(first, 1);
+	sent();
+	display_t *third = screenSetAddPage(set);
+	window_t *three = newWindow(third, 0, 0, 0, ROWS, COLS);
+	windowPrint(three, "third", 0, 0);
+	displayUpdate(third);
+	CHECK(set->active == NULL && strlen(sent()) == 0);
+	displaySetHide(third, 0);
+	out = sent();
+	CHECK(set->active == third);
+	CHECK(strstr(out, set->profile->cursor_hide) != NULL);
+	CHECK(strstr(out, "third") != NULL);
+
+	freeWindow(one);
+	freeWindow(two);
+	freeWindow(three);
+	freeScreenSet(set);
+	fclose(term);
+	free(data);
+	return checkResult();
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <display.h>
+
+/**
+ * displayReplay plays a recording made with displayStartRecording back
+ * through the display library.
+ *
+ * displayReplay <recording> [-t seconds] [-s speed] [-f]
+ *   -t start this many seconds into the recording
+ *   -s play back at this speed, 0 for as fast as possible
+ *   -f show only the frame at the start time and exit
+ */
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s <recording> [-t seconds] [-s speed] [-f]\n", name);
+	exit(1);
+}
+
+static void draw(display_t *display, window_t *window, replay_t *replay)
+{
+	int i;
+	for (i = 0; i < replay->rows; i++)
+	{
+		span_t *span = &replay->damage[i];
+		if (span->start >= span->end)
+			continue;
+		windowPutCells(window, replay->cells + (size_t)i * replay->cols + span->start,
+					span->end - span->start, i, span->start);
+		span->start = 0;
+		span->end = 0;
+	}
+	displayUpdate(display);
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = 0;
+	double speed = 1;
+	int frame_only = 0;
+	int opt;
+	while ((opt = getopt(argc, argv, "t:s:f")) != -1)
+	{
+		switch (opt)
+		{
+			case 't': seconds = atof(optarg); break;
+			case 's': speed = atof(optarg); break;
+			case 'f': frame_only = 1; break;
+			default: usage(argv[0]);
+		}
+	}
+	if (optind >= argc)
+		usage(argv[0]);
+
+	replay_t *replay = openReplay(argv[optind]);
+	if (replay == NULL || !replaySeek(replay, replay->start + (uint64_t)(seconds * 1000000)))
+	{
+		fprintf(stderr, "%s: cannot replay %s\n", argv[0], argv[optind]);
+		return 1;
+	}
+
+	display_t *display = newDisplay(stdout, replay->rows, replay->cols);
+	// planes the recording has no colors for keep the terminal's own
+	displaySetPlanes(display, replay->planes);
+	window_t *window = newCellWindow(display, 0, 0, replay->rows, replay->cols);
+	replay->resized = 0;
+	draw(display, window, replay);
+
+	uint64_t last = replay->time;
+	while (!frame_only && replayNext(replay))
+	{
+		if (replay->resized)
+		{
+			freeWindow(window);
+			displaySetSize(display, replay->rows, replay->cols);
+			window = newCellWindow(display, 0, 0, replay->rows, replay->cols);
+			replay->resized = 0;
+		}
+		if (speed > 0 && replay->time > last)
+			usleep((useconds_t)((replay->time - last) / speed));
+		last = replay->time;
+		draw(display, window, replay);
+	}
+
+	if (frame_only)
+	{
+		printf("\033[%d;1H\033[?25h", replay->rows + 1);
+		fflush(stdout);
+		freeReplay(replay);
+		return 0;
+	}
+	freeWindow(window);
+	freeDisplay(display);
+	freeReplay(replay);
+	return 0;
+}